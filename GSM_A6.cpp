@@ -1,5 +1,12 @@
 #include "GSM_A6.h"
 
+#if defined(GSM_EEPROM_ADDRESS)
+  #include <EEPROM.h>
+#endif
+
+// Marks the operator as having been saved to EEPROM
+#define GSM_OPERATOR_SAVED 0x4B
+
 /*
   -	Baud Rate 9600
   -	Requires 5V Power
@@ -12,57 +19,128 @@
       receiving OK does not necessarily mean that the command has been completed.
   - Power consumption can spike to around	~700mA, average power use is much lower
 */
-GSM_A6::GSM_A6() : currentMessage(255) { }
+GSM_A6::GSM_A6() : GSM_A6(Serial) { }
 
 /*
-   Initialises the GSM Module and gets into sync with the GSM.
-   If the GSM fails to communicate with the Arduino this method
-   returns false.
+   Uses the GSM connected to the given serial port, this allows
+   multiple GSMs to be used on boards with more than one serial port.
 
-   @return true if the GSM is ready, false if communication with the GSM fails
+   @param serial The serial port the GSM is connected to
+   @param resetPin The pin switching the GSM's reset pin to ground
+   @param powerPin The pin switching the MOSFET on the GSM's ground
  */
-bool GSM_A6::init() {
-  #if defined( DEBUG_GSM ) // Enable or Disable debug logging
-    if (!SD.begin(10)) {
-      isDebugging = false;
-      Serial.println(F("Failed - Debugging"));
-    } else {
-      Serial.println(F("Success - Debugging GSM"));
-      isDebugging = true;
-      myFile = SD.open("GSM_log.txt", FILE_WRITE);
-      myFile.println(F("Starting: "));
-    }
-    if (myFile) {
-      myFile.println(F("Initailising GSM..."));
-    }
-  #endif
+GSM_A6::GSM_A6(HardwareSerial & serial, int8_t resetPin, int8_t powerPin)
+  : serial(serial), hardwareSerial(&serial), resetPin(resetPin), powerPin(powerPin), dtrPin(-1), isAsleep(false), tx(serial),
+    currentMessage(255), processedMessages(0), seenMessages(0), responseLength(0), isResponseCutShort(false), timedCommand(0), operation(GSM_NO_OPERATION), callback(NULL),
+    waiting(NOT_WAITING), bringUpTo(GSM_NO_OPERATION), isSuccessful(false),
+    isSilent(false), silentResponses(0), isWedged(false), isAutoRecoveryUsed(true), isRecovering(false),
+    sessionState(GSM_NO_OPERATION), metrics(), registration(), operatorCode(), operatorTech(-1),
+    isOperatorCacheUsed(false), isOperatorSelected(false),
+    clockTime(0), clockSyncedAt(0), clockDrift(0), isDnsCacheUsed(false), isAdaptiveTimeoutUsed(false), isFailureFinal(false), dataStart(0), isIdentifying(false) { }
 
-  if (!attemptSync("AT")) {
-    #if defined( DEBUG_GSM )
-      if (!attemptSync("AT")) {
-        if (!attemptAutoTune()) return false;
-      }
-    #else
-      return false;
-    #endif
+/*
+   Uses a GSM connected to any other Stream, such as SoftwareSerial.
+   The baud rate can't be auto tuned on these connections.
+ */
+GSM_A6::GSM_A6(Stream & serial, int8_t resetPin, int8_t powerPin)
+  : serial(serial), hardwareSerial(NULL), resetPin(resetPin), powerPin(powerPin), dtrPin(-1), isAsleep(false), tx(serial),
+    currentMessage(255), processedMessages(0), seenMessages(0), responseLength(0), isResponseCutShort(false), timedCommand(0), operation(GSM_NO_OPERATION), callback(NULL),
+    waiting(NOT_WAITING), bringUpTo(GSM_NO_OPERATION), isSuccessful(false),
+    isSilent(false), silentResponses(0), isWedged(false), isAutoRecoveryUsed(true), isRecovering(false),
+    sessionState(GSM_NO_OPERATION), metrics(), registration(), operatorCode(), operatorTech(-1),
+    isOperatorCacheUsed(false), isOperatorSelected(false),
+    clockTime(0), clockSyncedAt(0), clockDrift(0), isDnsCacheUsed(false), isAdaptiveTimeoutUsed(false), isFailureFinal(false), dataStart(0), isIdentifying(false) { }
+
+/*
+   Turns the power on/off to the GSM, by switching the pin
+   connected to the MOSFET on the GSM's ground.
+
+   @param isOn true to power the GSM on
+
+   @return false if no power pin was given to the constructor
+ */
+bool GSM_A6::setPower(bool isOn) {
+  if (powerPin < 0) return false;
+
+  // Input is thrown away after switching each pin, as it was sent before the switch.
+  // This also lets a GSM_Simulator see the switch straight away.
+  pinMode(powerPin, OUTPUT);
+  if (isOn) {
+    digitalWrite(powerPin, HIGH);
+    discardInput();
+    GSM_delay(6000); // GSM Needs to initialise
+  } else {
+    digitalWrite(powerPin, LOW);
+    discardInput();
+    GSM_delay(100);
   }
+  sessionState = GSM_NO_OPERATION;
+  isAsleep = false;
+  return true;
+}
 
-  #if defined( DEBUG_GSM )
-    if (myFile) {
-      myFile.println(F("Success - In Sync"));
-      myFile.println(F("Preparing"));
-    }
-  #endif
-  
-  sendAndWait("&F0"); // Reset Settings
-  sendAndWait("E0"); // disable Echo
-  sendAndWait("+CMEE=2"); // enable better error messages
-  sendAndWait("+CPMS=\"SM\",\"SM\",\"SM\""); // Set SMS Storage for 3 memory areas
-  sendAndWait("+CMGF=1");
+/*
+   Triggers a reset on the GSM, by connecting the reset pin on
+   the GSM to ground. (Used after switching on the GSM to prevent
+   bugs occurring)
 
+   @return false if no reset pin was given to the constructor
+ */
+bool GSM_A6::reset() {
+  if (resetPin < 0) return false;
+
+  pinMode(resetPin, OUTPUT);
+  digitalWrite(resetPin, HIGH);
+  discardInput();
+  GSM_delay(2000);
+  digitalWrite(resetPin, LOW);
+  discardInput();
+  GSM_delay(6000); // Give the GSM sufficient time to reinitialise
+  sessionState = GSM_NO_OPERATION;
+  isAsleep = false;
   return true;
 }
 
+/*
+   Resets the GSM using the reset pin, or by switching the power off and
+   on if there is only a power pin. Then initialises the GSM, waits for
+   the network and connects to the APN again, as far as the GSM had got
+   before it was reset.
+
+   @return false if the GSM is still not working, or no pins were given
+ */
+bool GSM_A6::recover() {
+  uint16_t recoveries = metrics.recoveries;
+  if (!beginRecover()) return false;
+
+  runOperation();
+  return metrics.recoveries != recoveries;
+}
+
+/*
+   When enabled the GSM is recovered straight after an operation fails
+   because the GSM has stopped working. That is when several commands in
+   a row get no reply at all, AT gets no reply or a fatal error is reported.
+   The callback is called for the failed operation and then with
+   GSM_RECOVER once recovery has finished.
+
+   Enabled by default, it needs a reset or power pin to work.
+ */
+void GSM_A6::useAutoRecovery(bool isEnabled) {
+  isAutoRecoveryUsed = isEnabled;
+}
+
+/*
+   Initialises the GSM Module and gets into sync with the GSM.
+   If the GSM fails to communicate with the Arduino this method
+   returns false.
+
+   @return true if the GSM is ready, false if communication with the GSM fails
+ */
+bool GSM_A6::init() {
+  return beginInit() && runOperation();
+}
+
 /*
    Tries to initailise communication with the GSM, using it's auto syncing ability.
    It sends the given command multiple times.
@@ -70,26 +148,26 @@ bool GSM_A6::init() {
 */
 bool GSM_A6::attemptSync(const String & command) {
   for (uint8_t i = 0; i < 20; ++i) {
-    Serial.print(command);
-    Serial.print(GSM_END);
-    Serial.flush();
-    delay(40);
+    tx.print(command);
+    tx.print(GSM_END);
+    tx.send();
+    GSM_delay(40);
   }
 
   bool hasResponse = false;
   uint8_t counter = 0; // Time out counter
 
   while (!hasResponse && counter < 10) {
-    delay(50);
-    Serial.print(command);
-    Serial.print(GSM_END);
-    Serial.flush();
+    GSM_delay(50);
+    tx.print(command);
+    tx.print(GSM_END);
+    tx.send();
     hasResponse = waitFor("OK", 150) == 2;
     if (hasResponse) {
-      delay(50);
-      Serial.print(command);
-      Serial.print(GSM_END);
-      Serial.flush();
+      GSM_delay(50);
+      tx.print(command);
+      tx.print(GSM_END);
+      tx.send();
       hasResponse = waitFor("OK", 150) == 2;
     }
     ++counter;
@@ -98,43 +176,142 @@ bool GSM_A6::attemptSync(const String & command) {
   return (counter < 10);
 }
 
-#if defined( DEBUG_GSM )
+/*
+  Turns on hardware flow control, so large amounts of data can be sent
+  at high baud rates without overrunning the GSM.
+
+  @param ctsPin The pin connected to the GSM's CTS pin, nothing is
+                 written to the GSM while it is high
+  @param rtsPin The pin connected to the GSM's RTS pin, -1 if not connected.
+                 It is kept low so the GSM can always send.
+
+  @return true if the GSM turned on flow control
+*/
+bool GSM_A6::useFlowControl(int8_t ctsPin, int8_t rtsPin) {
+  if (rtsPin >= 0) {
+    pinMode(rtsPin, OUTPUT);
+    digitalWrite(rtsPin, LOW);
+  }
+
+  // +IFC=<GSM stopped by RTS>,<Arduino stopped by CTS>
+  if (!sendAndWait(rtsPin >= 0 ? F("+IFC=2,2") : F("+IFC=0,2"))) return false;
+
+  pinMode(ctsPin, INPUT);
+  tx.useFlowControl(ctsPin);
+  return true;
+}
+
+/*
+   Wakes the GSM from sleep() with its DTR pin, instead of by sending
+   commands. The pin is kept low while the GSM is awake.
+
+   @param dtrPin The pin connected to the GSM's DTR pin
+*/
+void GSM_A6::useSleepPin(int8_t dtrPin) {
+  this->dtrPin = dtrPin;
+  pinMode(dtrPin, OUTPUT);
+  digitalWrite(dtrPin, LOW);
+}
+
+/*
+   Puts the GSM into sleep mode, where it uses a few milliamps but stays
+   registered with the network and connected to the APN, so wake() can
+   carry on uploading within a second. Switching the power off instead
+   means init(), waitForNetwork() and connectToAPN() all over again.
+
+   With a DTR pin (useSleepPin()) the GSM sleeps until the pin is pulled
+   low (+CSCLK=1), otherwise it sleeps whenever it has been idle for a
+   few seconds and wakes on the next command (+CSCLK=2). Other methods
+   shouldn't be used until wake() has been called.
+
+   @return false if the GSM doesn't support sleep mode
+*/
+bool GSM_A6::sleep() {
+  if (isAsleep) return true;
+  if (!sendAndWait(dtrPin >= 0 ? F("+CSCLK=1") : F("+CSCLK=2"))) return false;
+
+  if (dtrPin >= 0) {
+    digitalWrite(dtrPin, HIGH);
+    discardInput();
+  }
+  isAsleep = true;
+  logger.println(F("Sleeping"));
+  return true;
+}
+
+/*
+   Wakes the GSM from sleep(), then checks it is still registered
+   with the network. getMetrics().wakeTime is the time it took.
+
+   @return true once the GSM is awake and registered, false if it didn't
+           wake up or needs waitForNetwork() before it can be used
+*/
+bool GSM_A6::wake() {
+  unsigned long start = GSM_millis();
+  if (dtrPin >= 0) {
+    digitalWrite(dtrPin, LOW);
+    discardInput();
+    GSM_delay(50);
+  }
+
+  // The GSM may miss the first characters while waking, so AT is sent until it answers
+  bool isAwake = false;
+  for (uint8_t i = 0; i < 10 && !isAwake; ++i) {
+    discardInput();
+    sendAT();
+    beginResponse("OK", 150);
+    isAwake = completeResponse() == SUCCESS;
+  }
+  if (!isAwake || !sendAndWait(F("+CSCLK=0"))) {
+    logger.println(F("Failed - Wake"));
+    return false;
+  }
+
+  isAsleep = false;
+  metrics.wakeTime = GSM_millis() - start;
+  return sendAndWait(F("+CREG?"), "+CREG:", 1, 2000) && isRegistered();
+}
+
+// Baud rates searched when the GSM can't be synced with, see attemptAutoTune()
+const uint32_t GSM_A6::BAUD_RATES[GSM_BAUD_RATE_COUNT] PROGMEM = {
+  300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 74880, 115200
+};
+
 /*
   Loops through all the baud rates to see if it can find the current
-  one the GSM is operating at.
+  one the GSM is operating at. This waits for the GSM at each baud rate,
+  init() and beginInit() search them in the background instead.
 
   @return true if a line of communication has been setup with the GSM
 */
 bool GSM_A6::attemptAutoTune() {
+  // Only a hardware serial port can change its baud rate
+  if (!hardwareSerial) return false;
 
   uint8_t iterations = 0;
   uint8_t currentBaudRate = 0;
-  long int baudRate[10] = { 300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 74880, 115200};
 
   while ((!attemptSync("AT")) && iterations < 2) {
     ++currentBaudRate;
-    if (currentBaudRate == 10) {
+    if (currentBaudRate == GSM_BAUD_RATE_COUNT) {
       currentBaudRate = 0;
       ++iterations;
     }
-    Serial.flush();
-    Serial.begin(baudRate[currentBaudRate]);
+    hardwareSerial->flush();
+    hardwareSerial->begin(pgm_read_dword(&BAUD_RATES[currentBaudRate]));
   }
 
   if (!(iterations == 2)) {
-    myFile.println("Baud Rate Found at: ");
-    myFile.println(baudRate[currentBaudRate]);
+    logger.println(F("Baud Rate Found at: "));
+    logger.println(pgm_read_dword(&BAUD_RATES[currentBaudRate]));
   } else {
-    Serial.begin(9600);
-    Serial.println(F("Baud Rate not Found"));
-    Serial.println(F("Baud Rate not Found"));
+    hardwareSerial->begin(9600);
+    logger.println(F("Baud Rate not Found"));
   }
 
   return !(iterations == 2);
 }
 
-#endif
-
 /*
   Sets the Network Provider
 
@@ -165,120 +342,7 @@ bool GSM_A6::setMobileNetwork(uint8_t networkProvider) {
   @return true if the network was setup correctly, or false if it could not set the network up.
 */
 bool GSM_A6::connectToAPN(const String & apn, const String & username, const String & password) {
-  #if defined( DEBUG_GSM )
-    // Get network status for debugging
-    if (myFile) {
-      myFile.println(F("Getting Network Status:"));
-    }
-    sendAndWait("+CIPSTATUS", "IP INITIAL", 2);
-    
-    //Attach Network - Page 133 & 136
-    if (!sendAndWait("+CGATT=1", 4)) {
-      if (myFile) {
-        myFile.println(F("Failed - Attach Network"));
-      }
-      return false;
-    }
-    delay(1000);
-
-    if (!sendAndWait("+CGATT?", 4)) {
-      if (myFile) {
-        myFile.println(F("Failed - Attach Network"));
-      }
-      return false;
-    }
-    delay(1000);
-
-    // Define PDP Context page 134
-    if (!sendAndWait("+CGDCONT=1,\"IP\",\"" + apn + "\"")) {
-      if (myFile) {
-        myFile.println(F("Failed - Define PDP Context"));
-      }
-      return false;
-    }
-    delay(1000);
-
-    //Set APN Details - Page 159
-    if (!sendAndWait("+CSTT=\"" + apn + "\",\"" + username + "\",\"" + password + "\"")) {
-      if (myFile) {
-        myFile.println(F("Failed - Set APN Settings"));
-      }
-      return false;
-    }
-    delay(1500); 
-
-    //Activate PDP Context - Page 136
-    if (!sendAndWait(F("+CGACT=1,1"), 4)) {
-      if (myFile) {
-        myFile.println(F("Failed - Activate PDP Context"));
-        myFile.print(F("GSM couldn't be attached to the mobile network "));
-        myFile.println(F("(check APN settings and SIM Card is activated)"));
-      }
-      return false;
-    }
-    delay(1000);
-
-    // Get network status for debugging
-    if (myFile) {
-      myFile.println(F("Getting Network Status:"));
-    }
-
-    // Check for old version first
-    if (!sendAndWait(F("+CIPSTATUS"), "IP GPRSACT", 2)) {
-      // The new version of the GSM A6 returns IP START here
-      // And it requires and additional command to ready the internet connection
-      if (sendAndWait(F("+CIPSTATUS"), "IP START" , 2)) {
-        if (myFile) {
-          myFile.println(F("Newer Version of GSM Detected, Firmware needs flash back"));
-        }
-        if (!sendAndWait(F("+CIICR"), 4)) return false;
-        delay(2000);
-      }
-    }
-
-    //Get IP Address - Page 161
-    if (!sendAndWait("+CIFSR", 4)) {
-      if (myFile) {
-        myFile.println(F("Failed - Get IP"));
-      }
-      return false;
-    }
-
-    if (!sendAndWait(F("+CIPSTATUS"), "OK" , 4)) return false;
-
-    if (myFile) {
-      myFile.println(F("Success - APN Connection"));
-    }
-
-    return true;
-  #else
-    //Attach Network - Page 133 & 136
-    if (!sendAndWait(F("+CGATT=1"), 4)) return false;
-    delay(1000);
-    // Define PDP Context page 134 01:25
-    if (!sendAndWait("+CGDCONT=1,\"IP\",\"" + apn + "\"")) return false;
-    delay(1000);
-    //Set APN Details - Page 159
-    if (!sendAndWait("+CSTT=\"" + apn + "\",\"" + username + "\",\"" + password + "\"")) return false;
-    delay(1500);
-    //Activate PDP Context - Page 136
-    if (!sendAndWait(F("+CGACT=1,1"), 4)) return false;
-    delay(1500);
-
-    // Check for older version first, as the GSM will then be quicker in the field
-    if (!sendAndWait(F("+CIPSTATUS"), "IP GPRSACT", 2)) {
-      // The new version of the GSM A6 returns IP START here
-      // And it requires and additional command to ready the internet connection
-      if (sendAndWait(F("+CIPSTATUS"), "IP START" , 2)) {
-        if (!sendAndWait(F("+CIICR"), 4)) return false;
-          delay(2000);
-      }
-    }
-    //Get IP Address - Page 161
-    if (!sendAndWait(F("+CIFSR"), 4)) return false;
-
-    return true;
-  #endif
+  return beginConnectToAPN(apn, username, password) && runOperation();
 }
 
 /*
@@ -302,43 +366,18 @@ Quality_Rating GSM_A6::getSignalStrength() {
     return VERY_GOOD;
   } else if (signalStrengthRAW <= 31) {
     return EXCELLENT;
-  } else if (signalStrengthRAW == 99) {
-    return NOT_KNOWN;
   }
+  return NOT_KNOWN;
 }
 
 /*
   Returns the raw value of the signal strength
 
-  @return signal strength
+  @return signal strength, 99 if not known
 */
 uint8_t GSM_A6::getSignalStrengthRAW() {
-  for (uint8_t i = 0; i < 2; ++i) {
-    sendCommand("+CSQ");
-    long start = millis();
-
-    while (millis() - start < 9000) {
-      String temp = Serial.readString();
-
-      #if defined( DEBUG_GSM )
-        captureResponse(temp, start);
-      #endif
-
-      if (temp.indexOf("OK") > 0) {
-        uint8_t numEnd = temp.indexOf(",");
-        return temp.substring(numEnd - 2, numEnd).toInt();
-      } else if (temp.indexOf("ERROR")) {
-        if (temp.indexOf("Excute command failure") > 0) {
-          break;
-        } else if (temp.indexOf("Unknown error") > 0) {
-          break;
-        } else if (temp.indexOf("FATAL ERROR") > 0) {
-          return 99;
-        }
-      }
-    }
-
-  }
+  uint8_t strength, bitErrorRate;
+  return getSignalQuality(strength, bitErrorRate) ? strength : 99;
 }
 
 /*
@@ -347,64 +386,278 @@ uint8_t GSM_A6::getSignalStrengthRAW() {
   @return Quality_Rating of the Error rate
 */
 Quality_Rating GSM_A6::getSignalBitErrorRate() {
-  for (uint8_t i = 0; i < 2; ++i) {
-    sendCommand("+CSQ");
-    long start = millis();
-
-    while (millis() - start < 9000) {
-      String temp = Serial.readString();
-
-      #if defined( DEBUG_GSM )
-        captureResponse(temp, start);
-      #endif
-
-      if (temp.indexOf("OK") > 0) {
-        uint8_t numEnd = temp.indexOf(",");
-        return temp.substring(numEnd + 1, numEnd + 3).toInt();
-      } else if (temp.indexOf("ERROR")) {
-        if (temp.indexOf("Excute command failure") > 0) {
-          break;
-        } else if (temp.indexOf("Unknown error") > 0) {
-          break;
-        } else if (temp.indexOf("FATAL ERROR") > 0) {
-          return 99;
-        }
-      }
-    }
+  uint8_t strength, bitErrorRate;
+  return getSignalQuality(strength, bitErrorRate) ? (Quality_Rating) bitErrorRate : NOT_KNOWN;
+}
+
+/*
+  Reads both values from the signal quality report, +CSQ: <strength>,<bit error rate>
+
+  @return true if the GSM reported the signal quality
+*/
+bool GSM_A6::getSignalQuality(uint8_t & strength, uint8_t & bitErrorRate) {
+  if (!sendAndWait(F("+CSQ"), "+CSQ:", 2, 9000)) return false;
+
+  const char * values = strstr(response, "+CSQ:") + 5;
+  strength = atoi(values);
+  const char * comma = strchr(values, ',');
+  bitErrorRate = comma ? atoi(comma + 1) : 99;
+  return true;
+}
+
+/*
+  Sets the clock to the GSM's time, which the mobile network keeps
+  up to date. Syncing again at least once a day corrects for the
+  Arduino's clock running fast or slow, see getTime().
 
+  @return true if the GSM knew the time
+*/
+bool GSM_A6::syncClock() {
+  // +CCLK: "yy/MM/dd,hh:mm:ss+zz"
+  if (!sendAndWait(F("+CCLK?"), "+CCLK:", 2, 5000L)) return false;
+
+  uint32_t time = GSM_parseTime(strchr(response, '"'));
+  // Until the network sets it the GSM's clock starts from an earlier year
+  if (time < 1514764800UL) return false; // 1 Jan 2018
+
+  unsigned long now = GSM_millis();
+  uint32_t seconds = (now - clockSyncedAt) / 1000;
+
+  // Only measured over an hour or more, as the GSM's time is to the second
+  if (clockTime != 0 && seconds >= 3600) {
+    int32_t error = (int32_t) (time - getTime());
+    clockDrift += (int64_t) error * 1000000L / seconds;
+    clockDrift = constrain(clockDrift, -50000L, 50000L);
   }
+
+  clockTime = time;
+  clockSyncedAt = now;
+  return true;
+}
+
+/*
+  Gets the time from the clock set by syncClock(), which is kept
+  using millis() between syncs.
+
+  @return seconds since 1 Jan 1970 UTC, 0 if the clock hasn't been synced
+*/
+uint32_t GSM_A6::getTime() {
+  if (clockTime == 0) return 0;
+
+  int64_t elapsed = GSM_millis() - clockSyncedAt;
+  elapsed += elapsed * clockDrift / 1000000L;
+  return clockTime + (uint32_t) (elapsed / 1000);
 }
 
 /**
    Initialises a TCP Connection with the server.
-   This needs to be called before a HTTP Header can be sent.
+   This needs to be called before a HTTP Header can be sent,
+   written to getConnection() so it is counted in getDataUsage().
 
    @param server The domain name or IP Address of the server
 
    @return true if a TCP Connection could be established or false if it can't.
  */
 bool GSM_A6::startTCPConnection(const String & server) {
-  #if defined( DEBUG_GSM )
-    if (myFile) {
-      myFile.println(F("Making Get Request..."));
-    }
+  return beginStartTCPConnection(server) && runOperation();
+}
+
+#if defined(GSM_SD_SUPPORT)
+/**
+   Sends a file from the SD Card to the server in a HTTP POST request,
+   such as the debug log or stored readings. The file is read straight
+   into the data sent to the GSM 512 bytes at a time, so the file isn't
+   copied into RAM.
+
+   The part of the file sent is given by a Content-Range header. If the
+   connection drops the file can be sent again with the same offset, to
+   carry on from where it stopped. Nothing is sent if the offset is
+   already at the end of the file, or the file is empty.
+
+   @param server The domain name or IP Address of the server
+   @param resource The resource the file is posted to, such as /upload
+   @param file An open file
+   @param offset The position in the file to start from, this is moved
+                  forward after each block the GSM sends
+
+   @return true if the rest of the file was sent
+ */
+bool GSM_A6::sendFile(const String & server, const String & resource, File & file, uint32_t & offset) {
+  return beginSendFile(server, resource, file, offset) && runOperation();
+}
+#endif
+
+/*
+   Connects to servers using the IP Address the GSM last found for them,
+   instead of the GSM looking up the server name on every connection.
+   If the connection fails the server is looked up again.
+   Results are kept in EEPROM if GSM_EEPROM_ADDRESS is defined.
+
+   @param isEnabled true to use the cache
+ */
+void GSM_A6::useDnsCache(bool isEnabled) {
+  isDnsCacheUsed = isEnabled;
+  #if defined(GSM_EEPROM_ADDRESS)
+    if (isEnabled) dnsCache.load(GSM_EEPROM_DNS);
   #endif
+}
 
-  if (!sendAndWait("+CIPSTART=\"TCP\",\"" + server + "\",80")) {
-    #if defined( DEBUG_GSM )
-      if (myFile) {
-        myFile.println(F("Failed"));
-      }
-    #endif
-    return false;
-  }
-  delay(150);
+/*
+   Waits for each command only as long as the command usually takes
+   to be answered, learnt from the responses so far, rather than the
+   full timeout. Failures are then spotted and retried much sooner.
+   The timeout given to each command is used until the command has
+   been answered a few times, and is still the longest it may take.
+   What has been learnt is kept in EEPROM if GSM_EEPROM_ADDRESS is defined.
+
+   @param isEnabled true to learn the timeouts
+ */
+void GSM_A6::useAdaptiveTimeouts(bool isEnabled) {
+  isAdaptiveTimeoutUsed = isEnabled;
+  #if defined(GSM_EEPROM_ADDRESS)
+    if (isEnabled) timeouts.load(GSM_EEPROM_TIMEOUTS);
+  #endif
+}
 
-  if (!sendAndWait("+CIPSEND", ">")) {
-    return false;
-  }
+/*
+   Registers with the operator last registered with, instead of the GSM
+   searching every operator after a cold start. waitForNetwork() asks
+   for that operator first (+COPS=4), and the GSM searches as usual if
+   it can't be registered with. The operator is asked for (+COPS?)
+   each time the GSM registers. getMetrics() has the time taken to
+   register with and without the operator being selected.
+   The operator is kept in EEPROM if GSM_EEPROM_ADDRESS is defined.
+
+   @param isEnabled true to select the last operator
+ */
+void GSM_A6::useOperatorCache(bool isEnabled) {
+  isOperatorCacheUsed = isEnabled;
+  if (isEnabled) loadOperator();
+}
 
-  return true;
+/*
+   @return the numeric code of the last operator registered with,
+           such as "23410", empty if not known, see useOperatorCache()
+ */
+const char * GSM_A6::getOperator() {
+  return operatorCode;
+}
+
+/*
+   @return counters recorded since the GSM was created
+ */
+const GSM_Metrics & GSM_A6::getMetrics() {
+  metrics.txTime = tx.writeTime;
+  return metrics;
+}
+
+static void printMetric(Print & output, char separator, const __FlashStringHelper * name, uint32_t value) {
+  output.print(separator);
+  output.print('"');
+  output.print(name);
+  output.print(F("\":"));
+  output.print(value);
+}
+
+/*
+   Prints the metrics as one line of JSON, such as {"dnsHits":3,"dnsMisses":1,...},
+   so they can be collected from the serial port and compared.
+ */
+void GSM_A6::printMetrics(Print & output) {
+  const GSM_Metrics & metrics = getMetrics();
+  printMetric(output, '{', F("dnsHits"), metrics.dnsHits);
+  printMetric(output, ',', F("dnsMisses"), metrics.dnsMisses);
+  printMetric(output, ',', F("dnsFailures"), metrics.dnsFailures);
+  printMetric(output, ',', F("connectionsByIP"), metrics.connectionsByIP);
+  printMetric(output, ',', F("connectionsByName"), metrics.connectionsByName);
+  printMetric(output, ',', F("connectTimeByIP"), metrics.connectTimeByIP);
+  printMetric(output, ',', F("connectTimeByName"), metrics.connectTimeByName);
+  printMetric(output, ',', F("timeToRegister"), metrics.timeToRegister);
+  printMetric(output, ',', F("registrationsByCache"), metrics.registrationsByCache);
+  printMetric(output, ',', F("registrationsByScan"), metrics.registrationsByScan);
+  printMetric(output, ',', F("registerTimeByCache"), metrics.registerTimeByCache);
+  printMetric(output, ',', F("registerTimeByScan"), metrics.registerTimeByScan);
+  printMetric(output, ',', F("txTime"), metrics.txTime);
+  printMetric(output, ',', F("recoveries"), metrics.recoveries);
+  printMetric(output, ',', F("failedRecoveries"), metrics.failedRecoveries);
+  printMetric(output, ',', F("recoveryTime"), metrics.recoveryTime);
+  printMetric(output, ',', F("retries"), metrics.retries);
+  printMetric(output, ',', F("rejectedRequests"), metrics.rejectedRequests);
+  printMetric(output, ',', F("wakeTime"), metrics.wakeTime);
+  output.println('}');
+}
+
+/*
+   Counted as the GSM sends and receives, the headers of each packet
+   are estimated, see GSM_Usage.
+
+   @return the data used since the GSM was created
+ */
+const GSM_DataUsage & GSM_A6::getDataUsage() {
+  return usage.session;
+}
+
+/*
+   The month is taken from getTime(), counting carries on in the last
+   month until the clock has been synced. Kept in EEPROM if
+   GSM_EEPROM_ADDRESS is defined, saved after each SMS or every 1KB.
+
+   @return the data used this month
+ */
+const GSM_DataUsage & GSM_A6::getMonthlyDataUsage() {
+  return usage.month;
+}
+
+/*
+   Requests and SMS fail straight away once this month's budget has
+   been used, counted in getMetrics().rejectedRequests.
+
+   @param bytes The most bytes each month, including the estimated headers, 0 for no limit
+   @param smsParts The most SMS parts each month, 0 for no limit
+ */
+void GSM_A6::setDataBudget(uint32_t bytes, uint16_t smsParts) {
+  usage.budget = bytes;
+  usage.smsBudget = smsParts;
+}
+
+/*
+   The policy can be changed at any time, such as
+   gsm.getRetryPolicy().requestAttempts = 3;
+
+   @return how failed commands and requests are tried again
+ */
+GSM_RetryPolicy & GSM_A6::getRetryPolicy() {
+  return retryPolicy;
+}
+
+/*
+   The registration is updated whenever the GSM reports it, which
+   is while waiting for a response to a command or for the network.
+
+   @return the last registration reported by the GSM
+ */
+const Network_Registration & GSM_A6::getRegistration() {
+  return registration;
+}
+
+/*
+   @return true if registered with the home network or roaming
+ */
+bool GSM_A6::isRegistered() {
+  return registration.status == REGISTERED_HOME || registration.status == REGISTERED_ROAMING;
+}
+
+/*
+   The GSM is identified by its reply to ATI each time it is initialised.
+   The bring up its firmware needs is found out with +CIPSTATUS the first
+   time it connects to the APN, then later connections skip straight to it.
+   It is found out again for a different firmware, or if connecting fails.
+   Kept in EEPROM if GSM_EEPROM_ADDRESS is defined.
+
+   @return the bring up the firmware needs, GSM_BRING_UP_UNKNOWN if not yet known
+ */
+GSM_BringUp GSM_A6::getBringUp() {
+  return firmware.getBringUp();
 }
 
 /**
@@ -413,45 +666,51 @@ bool GSM_A6::startTCPConnection(const String & server) {
    HTTP Header has been sent. An Example of a HTTP Header can be seen
    in the getRequest Method.
 
+   The data has already been sent, so if closing fails only the close
+   is made again, as many times as the retry policy makes requests.
+
    @return true if the TCP Connection was successfully close, otherwise false.
  */
 bool GSM_A6::closeTCPConnection() {
-  Serial.write(0x1A);
-  #if defined( DEBUG_GSM )
-    if (!waitFor()) {
-      if (myFile) {
-        myFile.println(F("Failed - Waiting"));
-      }
-    } else {
-      if (myFile) {
-        myFile.println(F("Success - Waiting"));
-      }
-    }
-  #else
-    waitFor();
-  #endif
-
+  usage.addSent(tx.count() - dataStart);
+  countUsage();
+  tx.write(0x1A);
+  tx.send();
+  if (waitFor() == SUCCESS) {
+    logger.println(F("Success - Waiting"));
+  } else {
+    logger.println(F("Failed - Waiting"));
+  }
 
   // Close connection
-  #if defined( DEBUG_GSM )
-    if (!sendAndWait("+CIPCLOSE")) {
-      if (myFile) {
-        myFile.println(F("Failed - Close Connection"));
-      }
-      return false;
-    } else {
-      if (myFile) {
-        myFile.println(F("Success - Close Connection"));
-      }
-      return true;
-    }
-  #else
-    if (!sendAndWait("+CIPCLOSE")) return false;
-  #endif
+  bool isClosed = sendAndWait(F("+CIPCLOSE"));
+  for (uint8_t i = 1; !isClosed && !isFailureFinal && i < retryPolicy.requestAttempts; ++i) {
+    ++metrics.retries;
+    logger.println(F("Retrying close..."));
+    GSM_delay(retryPolicy.backoff(i));
+    isClosed = sendAndWait(F("+CIPCLOSE"));
+  }
 
+  if (!isClosed) {
+    logger.println(F("Failed - Close Connection"));
+    return false;
+  }
+
+  logger.println(F("Success - Connection Closed"));
   return true;
 }
 
+/*
+   Data written to this after startTCPConnection() is sent with the
+   same buffer as the commands, and counted in getDataUsage().
+   Data can also be written straight to the serial port, but isn't counted.
+
+   @return where to write the data being sent to the server
+ */
+Print & GSM_A6::getConnection() {
+  return tx;
+}
+
 /*
    Makes a get request to the resource specified at server.
    This is not currently designed to return data from the server!
@@ -469,186 +728,126 @@ bool GSM_A6::closeTCPConnection() {
    @param resource The URL location of the resource you want to reach.
 */
 bool GSM_A6::getRequest(const String & server, const String & resource) {
+  return beginGetRequest(server, resource) && runOperation();
+}
 
-  #if defined( DEBUG_GSM )
-    if (myFile) {
-      myFile.println(F("Making Get Request..."));
-    }
-  #endif
+void GSM_A6::captureResponse(String &temp, long & start) {
+  logger.response(temp, start);
+}
 
-  if (!sendAndWait("+CIPSTART=\"TCP\",\"" + server + "\",80", 2)) {
-    #if defined( DEBUG_GSM )
-      if (myFile) {
-        myFile.println(F("Failed"));
-      }
-    #endif
-    return false;
-  }
-  delay(150);
+/*
+   Prints the contents recording from the debugging.
+*/
+void GSM_A6::printDebugFile() {
+  logger.dump(Serial);
+}
 
-  if (!sendAndWait("+CIPSEND", ">")) {
-    return false;
-  }
+/*
+   Ends the debugging session.
+*/
+void GSM_A6::stopDebugging() {
+  logger.end();
+}
 
-  Serial.print(F("GET "));
-  Serial.print(resource);
-  Serial.print(F(" HTTP/1.1\r\n"));
-  Serial.print(F("Host: "));
-  Serial.print(server);
-  Serial.print(F("\r\n"));
-  Serial.print(F("Connection: close\r\n\r\n"));
-  Serial.write(0x1A);
-
-  #if defined( DEBUG_GSM )
-    if (!waitFor()) {
-      if (myFile) {
-        myFile.println(F("Failed - Waiting"));
-      }
-    } else {
-      if (myFile) {
-        myFile.println(F("Success - Waiting"));
-      }
-    }
-  #else
-    waitFor();
-  #endif
+#if defined( DEBUG_GSM )
+File GSM_SdLogger::file;
+SdFat GSM_SdLogger::SD;
+bool GSM_SdLogger::isCardReady = false;
+bool GSM_SdLogger::isLineStart = true;
+uint8_t GSM_SdLogger::instances = 0;
 
+/*
+   Opens the log file on the SD Card, if another GSM has
+   already opened it the same file is used.
 
-  // Close connection
-  #if defined( DEBUG_GSM )
-    if (!sendAndWait("+CIPCLOSE")) {
-      if (myFile) {
-        myFile.println(F("Failed - Close Connection"));
-      }
+   @return true if the SD Card could be used for logging
+*/
+bool GSM_SdLogger::begin() {
+  if (!file) {
+    if (!isCardReady && !SD.begin(10)) {
+      Serial.println(F("Failed - Debugging"));
       return false;
-    } else {
-      if (myFile) {
-        myFile.println(F("Success - Connection Closed"));
-      }
-      return true;
     }
-  #else
-    if (!sendAndWait("+CIPCLOSE")) return false;
-  #endif
+    isCardReady = true;
 
-  return true;
+    Serial.println(F("Success - Debugging GSM"));
+    file = SD.open("GSM_log.txt", FILE_WRITE);
+    isLineStart = true;
+  }
+
+  println(F("Starting: "));
+  return file;
 }
 
-#if defined( DEBUG_GSM )
+/*
+   Tags the start of each line with the number of the GSM writing it.
 
-void GSM_A6::captureResponse(String &temp, long & start) {
-  if (temp.length() > 1) {
-    long currentTime = millis();
-    if (myFile) {
-      myFile.println(F("Response:"));
-      myFile.println(temp);
-      myFile.print(F("Time Taken (ms): "));
-      myFile.println(currentTime - start);
-    }
+   @return true if the log file is open
+*/
+bool GSM_SdLogger::startLine() {
+  if (!file) return false;
+
+  if (isLineStart) {
+    file.print('[');
+    file.print(id);
+    file.print(F("] "));
+    isLineStart = false;
   }
+  return true;
 }
 
 /*
-   Prints the contents recording from the debugging.
+   Records a response from the GSM along with how long it took to arrive.
 */
-void GSM_A6::printDebugFile() {
-  if (myFile) {
-    myFile.close();
+void GSM_SdLogger::response(const char * response, unsigned long start) {
+  if (strlen(response) > 1 && file) {
+    unsigned long currentTime = GSM_millis();
+    println(F("Response:"));
+    println(response);
+    print(F("Time Taken (ms): "));
+    println(currentTime - start);
   }
-  myFile = SD.open("GSM_log.txt");
-  if (myFile) {
-    Serial.println(F("Reading GSM Log"));
-    while (myFile.available()) {
-      Serial.write(myFile.read());
+}
+
+/*
+   Closes the log file and writes its contents to the output.
+   Logging stops for every GSM until one of them begins again.
+*/
+void GSM_SdLogger::dump(Print & output) {
+  if (file) {
+    file.close();
+  }
+  file = SD.open("GSM_log.txt");
+  if (file) {
+    output.println(F("Reading GSM Log"));
+    while (file.available()) {
+      output.write(file.read());
     }
-    myFile.close();
+    file.close();
   }
 }
 
 /*
-   Ends the debugging session.
+   Closes the log file, for every GSM.
 */
-void GSM_A6::stopDebugging() {
-  if (myFile) {
-    myFile.close();
+void GSM_SdLogger::end() {
+  if (file) {
+    file.close();
   }
 }
 #endif
 
 /*
-   Connects to the mobile network.
+   Connects to the mobile network. The GSM reports changes to the
+   registration itself, it is only asked again with back-off in case
+   a report is missed.
 
-   @param timeout The time in milliseconds to timeout after.
+   @param timeout The total time in milliseconds to wait for the network.
 
    @return true if the GSM successfully connected to the network else false.
 */
-bool GSM_A6::waitForNetwork(unsigned long timeout = 20000L) {
-  #if defined( DEBUG_GSM )
-    if (myFile) myFile.println(F("Connecting To Network..."));
-    
-    uint8_t counter = 0;
-    
-    while (counter < 40) {
-      ++counter;
-
-      sendCommand("+CREG?");
-      long start = millis();
-      while (millis() - start < timeout) {
-        String temp = Serial.readString();
-    
-        if (myFile) captureResponse(temp, start);
-        
-        int indexOf = temp.indexOf("+CREG: 1,1");
-
-        if (indexOf > 0 && isDigit(temp.charAt(indexOf + 10))) {
-          delay(1000);
-          break;
-        } else if (indexOf > 0) {
-          if (myFile) myFile.println(F("Success - Connected"));
-          return true;
-        } else if (temp.indexOf("ERROR") > 0) {
-          Serial.print(F("AT"));
-          Serial.print(GSM_END);
-          Serial.flush();
-          delay(1000);
-          Serial.readString();
-          break;
-        }
-      }
-    }
-    
-    if (myFile) myFile.println(F("Failed - Not Connected"));
-    return false;
-  #else
-    
-    uint8_t counter = 0;
-    
-    while (counter < 40) { // 5 seconds
-      ++counter;
-
-      sendCommand("+CREG?");
-      long start = millis();
-      while (millis() - start < timeout) {
-        String temp = Serial.readString();
-    
-        if (temp.indexOf("+CREG: 1,10") > 0) {
-          delay(100);
-          break;
-        } else if (temp.indexOf("+CREG: 1,1") > 0) {
-          return true;
-        } else if (temp.indexOf("ERROR") > 0) {
-          Serial.print(F("AT"));
-          Serial.print(GSM_END);
-          Serial.flush();
-          delay(100);
-          Serial.readString();
-          break;
-        }
-      }
-    }
-    
-    return false;
-  #endif
+bool GSM_A6::waitForNetwork(unsigned long timeout) {
+  return beginWaitForNetwork(timeout) && runOperation();
 }
 
 /*
@@ -662,44 +861,369 @@ bool GSM_A6::waitForNetwork(unsigned long timeout = 20000L) {
    @return 0 for a fatal error, 1 for a minor error (try resending command),
               2 desired response was recieved from the GSM.
 */
-uint8_t GSM_A6::waitFor(String expected = "OK", unsigned long timeout = 15000L) {
-  long start = millis();
-  while (millis() - start < timeout) {
-    String temp = Serial.readString();
+uint8_t GSM_A6::waitFor(const String expected, unsigned long timeout) {
+  beginResponse(expected.c_str(), timeout);
+  uint8_t result = completeResponse();
+  checkHealth(result, false);
+  learnTimeout(result);
+  classifyFailure(result);
+
+  if (result == FAILED) {
+    // Minor error, check the GSM is listening before carrying on
+    sendAT();
+    beginResponse("OK", 1000);
+    checkHealth(completeResponse(), true);
+  }
 
-  #if defined( DEBUG_GSM )
-    captureResponse(temp, start);
-  #endif
+  return result;
+}
+
+/*
+   Throws away anything the GSM has sent which hasn't been read yet,
+   so an old response can't be mistaken for the response to a new command.
+   Complete lines are still checked for reports such as +CREG.
+*/
+void GSM_A6::discardInput() {
+  responseLength = 0;
+  while (serial.available()) {
+    char c = serial.read();
+
+    if (c == '\n') {
+      response[responseLength] = '\0';
+      checkUnsolicited();
+      responseLength = 0;
+    } else if (c != '\r' && responseLength < GSM_RESPONSE_SIZE - 1) {
+      response[responseLength++] = c;
+    }
+  }
+  responseLength = 0;
+  response[0] = '\0';
+}
 
-    if (temp.indexOf(expected) > 0) {
-      return 2;
-    } else if (temp.indexOf("ERROR") > 0) {
-      if (temp.indexOf("Excute command failure") > 0) {
-        Serial.print(F("AT"));
-        Serial.print(GSM_END);
-        Serial.flush();
-        delay(100);
-        Serial.readString();
-        return 1;
-      } else if (temp.indexOf("Unknown error") > 0) {
-        Serial.print(F("AT"));
-        Serial.print(GSM_END);
-        Serial.flush();
-        delay(100);
-        Serial.readString();
-        return 1;
-      } else if (temp.indexOf("FATAL ERROR") > 0) {
-        return 0;
-      } else {
-        Serial.print(F("AT"));
-        Serial.print(GSM_END);
-        Serial.flush();
-        delay(100);
-        Serial.readString();
-        return 1;
+/*
+   Reads reports the GSM sends without being asked from the current line.
+   Replies to queries such as +CREG? are read the same way.
+*/
+void GSM_A6::checkUnsolicited() {
+  if (strncmp(response, "+CREG:", 6) == 0) {
+    readRegistration(response + 6);
+  } else if (strncmp(response, "+CIPRCV:", 8) == 0) {
+    usage.addReceived(atoi(response + 8));
+    countUsage();
+  }
+}
+
+static uint16_t readHex(const char * text) {
+  while (*text == ' ' || *text == '"') ++text;
+  return strtoul(text, NULL, 16);
+}
+
+/*
+   Reads the registration from either form of +CREG:
+     +CREG: <n>,<stat>[,"<lac>","<ci>"]  reply to +CREG?
+     +CREG: <stat>[,"<lac>","<ci>"]      sent when the registration changes
+*/
+void GSM_A6::readRegistration(const char * text) {
+  const char * fields[4];
+  uint8_t total = 0;
+
+  fields[total++] = text;
+  for (const char * c = text; *c != '\0' && total < 4; ++c) {
+    if (*c == ',') fields[total++] = c + 1;
+  }
+
+  uint8_t first = (total == 2 || total == 4) ? 1 : 0;
+  Registration_Status status = (Registration_Status) atoi(fields[first]);
+  if (status > REGISTERED_ROAMING) status = REGISTRATION_UNKNOWN;
+
+  if (status != registration.status) {
+    registration.status = status;
+    registration.changedAt = GSM_millis();
+  }
+
+  if (total - first == 3) {
+    // Location is in hex, such as "1A2B"
+    registration.locationAreaCode = readHex(fields[first + 1]);
+    registration.cellID = readHex(fields[first + 2]);
+  } else if (!isRegistered()) {
+    registration.locationAreaCode = 0;
+    registration.cellID = 0;
+  }
+}
+
+/*
+   Reads the operator from the reply to +COPS? in the numeric format:
+     +COPS: <mode>,2,"<operator>"[,<access technology>]
+   The operator is left as it was if the GSM isn't registered.
+
+   @return true if the operator changed
+*/
+bool GSM_A6::readOperator(const char * text) {
+  const char * format = strchr(text, ',');
+  const char * code = strchr(text, '"');
+  if (format == NULL || code == NULL || atoi(format + 1) != 2) return false;
+
+  char found[sizeof(operatorCode)];
+  uint8_t length = 0;
+  for (++code; isDigit(*code) && length < sizeof(found) - 1; ++code) {
+    found[length++] = *code;
+  }
+  found[length] = '\0';
+  if (length < 5 || *code != '"') return false;
+
+  const char * tech = strchr(code, ',');
+  int8_t foundTech = tech != NULL ? atoi(tech + 1) : -1;
+
+  if (strcmp(found, operatorCode) != 0 || foundTech != operatorTech) {
+    strcpy(operatorCode, found);
+    operatorTech = foundTech;
+    saveOperator();
+    return true;
+  }
+  return false;
+}
+
+void GSM_A6::loadOperator() {
+#if defined(GSM_EEPROM_ADDRESS)
+  if (EEPROM.read(GSM_EEPROM_OPERATOR) != GSM_OPERATOR_SAVED) return;
+  EEPROM.get(GSM_EEPROM_OPERATOR + 1, operatorCode);
+  operatorCode[sizeof(operatorCode) - 1] = '\0';
+  operatorTech = EEPROM.read(GSM_EEPROM_OPERATOR + 1 + sizeof(operatorCode));
+#endif
+}
+
+void GSM_A6::saveOperator() {
+#if defined(GSM_EEPROM_ADDRESS)
+  EEPROM.update(GSM_EEPROM_OPERATOR, GSM_OPERATOR_SAVED);
+  EEPROM.put(GSM_EEPROM_OPERATOR + 1, operatorCode);
+  EEPROM.update(GSM_EEPROM_OPERATOR + 1 + sizeof(operatorCode), operatorTech);
+#endif
+}
+
+/*
+   Sends the command and starts waiting for the response, see pollResponse().
+*/
+void GSM_A6::beginCommand(const String & command, const char * expected, unsigned long timeout) {
+  discardInput();
+  sendCommand(command);
+  beginResponse(expected, timeout);
+}
+
+/*
+   Starts waiting for a response, see pollResponse().
+
+   @param expected Part of the desired response, this must remain in memory
+                    until the response is complete.
+   @param timeout The time in milliseconds to timeout after.
+*/
+void GSM_A6::beginResponse(const char * expected, unsigned long timeout) {
+  this->expected = expected;
+  matcher.begin(expected);
+  responseType = GSM_RESPONSE_NONE;
+  responseLength = 0;
+  response[0] = '\0';
+  isSilent = true;
+  responseStart = GSM_millis();
+  fullTimeout = timeout;
+  responseTimeout = timedCommand != 0 ? timeouts.get(timedCommand, timeout) : timeout;
+}
+
+/*
+   Reads the response from the GSM one line at a time, without waiting
+   for more of the response to arrive. Each character is classified as
+   it arrives, the line is kept so the caller can read values from it.
+
+   @return PENDING until the response is complete, then the same as waitFor().
+*/
+uint8_t GSM_A6::pollResponse() {
+  while (serial.available()) {
+    char c = serial.read();
+
+    if (c == '\n') {
+      uint8_t result = checkResponse();
+      if (result != PENDING) return result;
+      responseLength = 0;
+      response[0] = '\0';
+      matcher.reset();
+    } else if (c != '\r') {
+      if (responseLength < GSM_RESPONSE_SIZE - 1) {
+        response[responseLength++] = c;
+        response[responseLength] = '\0';
+      }
+      matcher.add(c);
+
+      // Prompts such as '>' aren't followed by a new line
+      if (expected[0] == '>' && matcher.hasExpected()) {
+        responseType = GSM_RESPONSE_EXPECTED;
+        return SUCCESS;
       }
     }
   }
+
+  if (GSM_millis() - responseStart >= responseTimeout) return FAILED;
+  return PENDING;
+}
+
+/*
+   Checks a complete line of the response.
+
+   @return PENDING if the response continues on the next line
+*/
+uint8_t GSM_A6::checkResponse() {
+  if (responseLength == 0) return PENDING;
+
+  isSilent = false;
+  logger.response(response, responseStart);
+  checkUnsolicited();
+  retryPolicy.addEntropy(GSM_micros());
+
+  responseType = matcher.result();
+  switch (responseType) {
+    case GSM_RESPONSE_NONE:
+      if (isIdentifying) firmware.addIdentity(response);
+      return PENDING;
+    case GSM_RESPONSE_EXPECTED:
+      return SUCCESS;
+    case GSM_RESPONSE_FATAL_ERROR:
+      return FATAL_ERROR;
+    default: // Excute command failure, Unknown error and others are minor errors
+      return FAILED;
+  }
+}
+
+/*
+   Watches for signs the GSM has stopped working after each response,
+   see useAutoRecovery(). Any successful response shows it still works.
+
+   @param isProbe true if the response was to AT, sent to check the GSM
+*/
+void GSM_A6::checkHealth(uint8_t result, bool isProbe) {
+  if (result == SUCCESS) {
+    isWedged = false;
+    silentResponses = 0;
+  } else if (result == FATAL_ERROR) {
+    isWedged = true;
+  } else if (responseType == GSM_RESPONSE_CME_ERROR) {
+    // SIM failure, the GSM needs to be reset before it can use the SIM again
+    const char * error = strstr(response, "+CME ERROR:");
+    if (error != NULL && (atoi(error + 11) == 13 || strstr(error, "SIM failure"))) {
+      isWedged = true;
+    }
+  } else if (result == FAILED && isSilent) {
+    if (isProbe || ++silentResponses >= GSM_SILENT_LIMIT) isWedged = true;
+  } else {
+    silentResponses = 0;
+  }
+}
+
+/*
+   Learns how long the command took to be answered, see useAdaptiveTimeouts().
+   When nothing came back the full timeout given for the command is learnt,
+   rather than the shorter adaptive timeout, so it grows again. Errors and
+   other replies say nothing about how long the command takes to succeed,
+   so only the expected reply is learnt from.
+*/
+void GSM_A6::learnTimeout(uint8_t result) {
+  if (timedCommand == 0) return;
+  uint16_t command = timedCommand;
+  timedCommand = 0;
+
+  unsigned long time;
+  if (responseType == GSM_RESPONSE_EXPECTED) {
+    time = GSM_millis() - responseStart;
+  } else if (result == FAILED && isSilent) {
+    time = fullTimeout;
+  } else {
+    return;
+  }
+
+  if (timeouts.learn(command, time)) {
+    #if defined(GSM_EEPROM_ADDRESS)
+      timeouts.save(GSM_EEPROM_TIMEOUTS);
+    #endif
+  }
+}
+
+/*
+   Records if the command failed in a way sending it again won't fix,
+   see GSM_RetryPolicy. Must be called before anything else is read.
+*/
+void GSM_A6::classifyFailure(uint8_t result) {
+  isFailureFinal = result == FATAL_ERROR ||
+                   (result == FAILED && !GSM_RetryPolicy::isRetryable(responseType, response));
+  if (isFailureFinal) {
+    logger.print(F("Not retrying: "));
+    logger.println(response);
+  }
+}
+
+/*
+   Records the bring up the firmware was found to need while connecting
+   to the APN, kept in EEPROM if GSM_EEPROM_ADDRESS is defined.
+*/
+void GSM_A6::learnBringUp(GSM_BringUp bringUp) {
+  if (firmware.setBringUp(bringUp)) {
+    #if defined(GSM_EEPROM_ADDRESS)
+      firmware.save(GSM_EEPROM_FIRMWARE);
+    #endif
+  }
+}
+
+/*
+   Moves the monthly totals on to a new month and saves them when worth it,
+   called after anything is counted.
+*/
+void GSM_A6::countUsage() {
+  if (usage.update(getTime())) {
+    #if defined(GSM_EEPROM_ADDRESS)
+      usage.save(GSM_EEPROM_USAGE);
+    #endif
+  }
+}
+
+/*
+   Waits until the response started by beginResponse() is complete.
+*/
+uint8_t GSM_A6::completeResponse() {
+  uint8_t result;
+  do {
+    result = pollResponse();
+  } while (result == PENDING);
+  return result;
+}
+
+/*
+   Reads the next line from the GSM into the response, empty lines are skipped.
+
+   @param timeout The time in milliseconds to wait for the line.
+
+   @return false if a complete line didn't arrive in time
+*/
+bool GSM_A6::readLine(unsigned long timeout) {
+  unsigned long start = GSM_millis();
+  timedCommand = 0; // Responses read a line at a time aren't learnt from
+  responseLength = 0;
+  response[0] = '\0';
+  isResponseCutShort = false;
+
+  while (GSM_millis() - start < timeout) {
+    if (!serial.available()) continue;
+    char c = serial.read();
+
+    if (c == '\n') {
+      if (responseLength > 0) {
+        logger.response(response, start);
+        checkUnsolicited();
+        return true;
+      }
+    } else if (c != '\r' && responseLength < GSM_RESPONSE_SIZE - 1) {
+      response[responseLength++] = c;
+      response[responseLength] = '\0';
+    } else if (c != '\r') {
+      isResponseCutShort = true;
+    }
+  }
+  return false;
 }
 
 /*
@@ -713,33 +1237,27 @@ uint8_t GSM_A6::waitFor(String expected = "OK", unsigned long timeout = 15000L)
    @param command The command to send to the GSM.
 */
 void GSM_A6::sendCommand(const String & command) {
-  #if defined( DEBUG_GSM )
-    if (myFile) {
-      myFile.print(F("Command: AT"));
-      myFile.print(command);
-      myFile.print(GSM_END);
-    }
-  #endif
-
-  Serial.print(F("AT"));
-  Serial.print(command);
-  Serial.print(GSM_END);
-  Serial.flush();
+  logger.print(F("Command: AT"));
+  logger.print(command);
+  logger.print(GSM_END);
+
+  tx.print(F("AT"));
+  tx.print(command);
+  tx.print(GSM_END);
+  tx.send();
+  timedCommand = isAdaptiveTimeoutUsed ? GSM_Timeouts::hash(command) : 0;
 }
 
 /*
    Sends a basic AT command.
 */
 void GSM_A6::sendAT() {
-  #if defined( DEBUG_GSM )
-    if (myFile) {
-      myFile.print(F("Command: AT\r\n"));
-    }
-  #endif
+  logger.print(F("Command: AT\r\n"));
 
-  Serial.print(F("AT"));
-  Serial.print(GSM_END);
-  Serial.flush();
+  tx.print(F("AT"));
+  tx.print(GSM_END);
+  tx.send();
+  timedCommand = 0;
 }
 
 /*
@@ -751,7 +1269,7 @@ void GSM_A6::sendAT() {
 
    @return true if the GSM responsed with OK otherwise false.
 */
-bool GSM_A6::sendAndWait(const String & command, uint8_t repeatAmountOnMinorError = 2) {
+bool GSM_A6::sendAndWait(const String & command, uint8_t repeatAmountOnMinorError) {
   return sendAndWait(command, "OK", repeatAmountOnMinorError);
 }
 
@@ -762,16 +1280,25 @@ bool GSM_A6::sendAndWait(const String & command, uint8_t repeatAmountOnMinorErro
    @param expected The response to be expected from the GSM.
    @param repeatAmountOnMinorError The amount of times to retry and send the command
                                     if the GSM returns a minor error as a response.
+                                    Retries wait as given by getRetryPolicy(), errors
+                                    which won't go away such as a missing SIM aren't retried.
+   @param timeout The time in milliseconds to wait for each response.
 
    @return true if the GSM responsed with the expected response otherwise false.
 */
-bool GSM_A6::sendAndWait(const String & command, const String expected, uint8_t repeatAmountOnMinorError = 2) {
-  for (signed char i = 0; i < repeatAmountOnMinorError; ++i) {
+bool GSM_A6::sendAndWait(const String & command, const String expected, uint8_t repeatAmountOnMinorError, unsigned long timeout) {
+  for (uint8_t i = 0; i < repeatAmountOnMinorError; ++i) {
+    if (i > 0) {
+      ++metrics.retries;
+      GSM_delay(retryPolicy.backoff(i));
+    }
+
+    discardInput();
     sendCommand(command);
-    uint8_t status = waitFor(expected);
-    if (status == 2) {
+    uint8_t status = waitFor(expected, timeout);
+    if (status == SUCCESS) {
       return true;
-    } else if (status == 0) {
+    } else if (isFailureFinal) {
       return false;
     }
   }
@@ -781,12 +1308,24 @@ bool GSM_A6::sendAndWait(const String & command, const String expected, uint8_t
 /*
   Used to start a SMS Message, should be followed by a phone number
 
-  @return true if the SMS Message could be successfully started
+  @return true if the SMS Message could be successfully started, false while
+          the circuit is open (see GSM_RetryPolicy) or over the SMS budget
 */
 bool GSM_A6::startSMS() {
+  // Requests to servers are failing, so the network is likely down
+  if (retryPolicy.isOpen()) {
+    ++metrics.rejectedRequests;
+    return false;
+  }
+  if (usage.isOverBudget(true)) {
+    ++metrics.rejectedRequests;
+    logger.println(F("Failed - SMS Budget"));
+    return false;
+  }
   if (!sendAndWait("+CMGF=1")) return false;
-  delay(2000);
-  Serial.print("AT+CMGS=\"");
+  GSM_delay(2000);
+  tx.print(F("AT+CMGS=\""));
+  tx.send();
   return true;
 }
 
@@ -794,20 +1333,25 @@ bool GSM_A6::startSMS() {
   Marks the end of the phone number and the beginning of the SMS Body
 */
 void GSM_A6::enterSMSContent() {
-  Serial.write(0x22);
-  Serial.print(GSM_END);
-  delay(2000);
+  tx.write(0x22);
+  tx.print(GSM_END);
+  tx.send();
+  dataStart = tx.count();
+  GSM_delay(2000);
 }
 
 /*
   Finishes and sends the SMS Message
 */
 void GSM_A6::sendSMS() {
-  delay(500);
-  Serial.println(char(26));
-  Serial.print(GSM_END);
-  Serial.flush();
-  delay(1000);
+  // A message written straight to the serial port counts as one part
+  usage.addSMS(tx.count() - dataStart);
+  countUsage();
+  GSM_delay(500);
+  tx.println(char(26));
+  tx.print(GSM_END);
+  tx.send();
+  GSM_delay(1000);
 }
 
 /*
@@ -815,13 +1359,18 @@ void GSM_A6::sendSMS() {
 
   @param phoneNo The phone number to text
   @param message The message to send
+
+  @return false if the message couldn't be started, such as when the
+          circuit is open or the SMS budget has been spent, see startSMS()
 */
-void GSM_A6::quickSMS(const String & phoneNo, const String & message) {
-  startSMS();
-  Serial.print(phoneNo);
+bool GSM_A6::quickSMS(const String & phoneNo, const String & message) {
+  if (!startSMS()) return false;
+
+  tx.print(phoneNo);
   enterSMSContent();
-  Serial.print(message);
+  tx.print(message);
   sendSMS();
+  return true;
 }
 
 /*
@@ -836,57 +1385,9 @@ void GSM_A6::quickSMS(const String & phoneNo, const String & message) {
   @return number of messages, 0 if none are present.
 */
 uint8_t GSM_A6::totalMessages() {
-
-  for (uint8_t i = 0; i < 2; ++i) {
-
-    sendCommand("+CPMS?");
-
-    #if defined( DEBUG_GSM )
-      if (myFile) {
-        myFile.println(F("Response:"));
-      }
-      uint8_t counter = 0;
-    #endif
-
-    long start = millis();
-    while (millis() - start < 20000L) {
-      String data = Serial.readStringUntil(',');
-
-      #if defined( DEBUG_GSM )
-        if (myFile) {
-          ++counter;
-          if (data.length() > 1) {
-            myFile.print("Counter is: ");
-            myFile.println(counter);
-            myFile.print(data);
-            myFile.print(F(","));
-          }
-        }
-      #endif
-
-      if (data.indexOf("+CPMS: ") > -1) {
-        String data = Serial.readStringUntil(',');
-        uint8_t noOfMessages = data.charAt(data.length() - 1) -'0'; // Last character
-
-        #if defined( DEBUG_GSM )
-          if (myFile) {
-            myFile.print(data);
-            myFile.print(F(","));
-            data = Serial.readString();
-            myFile.println(data);
-            long currentTime = millis();
-            myFile.print(F("Time Taken (ms): "));
-            myFile.println(currentTime - start);
-          }
-        #else
-          Serial.readString();
-        #endif
-
-        return noOfMessages;
-      }
-    }
-  }
-  return 0;
+  // +CPMS: <used>,<total>,...
+  if (!sendAndWait(F("+CPMS?"), "+CPMS:", 2, 20000L)) return 0;
+  return atoi(strstr(response, "+CPMS:") + 6);
 }
 
 /*
@@ -925,96 +1426,56 @@ SMS_Message GSM_A6::getSMS(uint8_t messageID) {
   for (uint8_t i = 0; i < 2; ++i) {
     //AT + CMGR = [messageID]
     sendCommand("+CMGR=" + String(messageID));
+    logger.println(F("Response:"));
+
+    long start = GSM_millis();
+    while (GSM_millis() - start < 20000L) {
+      String data = serial.readStringUntil(',');
 
-    #if defined( DEBUG_GSM )
-      if (myFile) {
-        myFile.println(F("Response:"));
+      if (data.length() > 1) {
+        logger.print(data);
       }
-      uint8_t counter = 0;
-    #endif
-    
-    long start = millis();
-    while (millis() - start < 20000L) {
-      String data = Serial.readStringUntil(',');
-
-      #if defined( DEBUG_GSM )
-        if (myFile) {
-          ++counter;
-          if (data.length() > 1) {
-            myFile.print("Counter is: ");
-            myFile.println(counter);
-            myFile.print(data);
-          }
-        }
-      #endif
 
       if (data.indexOf("+CMGR: ") > -1) {
         //uint8_t indexBeforeNo = data.lastIndexOf("+CMGR: ") + 6;
         //newMessage.id = getMessageID(data);
         newMessage.id = messageID;
-        newMessage.status = data.indexOf("UNREAD") > -1 ? 1 : 0;
-
-        Serial.read();
-        data = Serial.readStringUntil(',');
-
-        #if defined( DEBUG_GSM )
-          if (myFile) {
-            myFile.print(F(","));
-            myFile.print(data);
-          }
-        #endif
-        
+        newMessage.status = data.indexOf("UNREAD") > -1 ? UNREAD : READ;
+
+        serial.read();
+        data = serial.readStringUntil(',');
+        logger.print(F(","));
+        logger.print(data);
+
         newMessage.sender = "0" + data.substring(4, 14);
 
         // Prints ,, - and any contents present between the comma's
-        Serial.read();
-        data = Serial.readStringUntil(',');
-        Serial.read();
-        
-        #if defined( DEBUG_GSM )
-          if (myFile) {
-            myFile.print(F(","));
-            myFile.print(data);
-            myFile.print(F(","));
-          }
-        #endif
-
-        data = Serial.readStringUntil(',');
+        serial.read();
+        data = serial.readStringUntil(',');
+        serial.read();
+        logger.print(F(","));
+        logger.print(data);
+        logger.print(F(","));
+
+        data = serial.readStringUntil(',');
         newMessage.timeReceived = data.substring(1, data.length());
-        Serial.read();
-        
-        #if defined( DEBUG_GSM )
-          if (myFile) {
-            myFile.print(data);
-            myFile.print(F(","));
-          }
-        #endif
-
-        data = Serial.readStringUntil('"');
+        serial.read();
+        logger.print(data);
+        logger.print(F(","));
+
+        data = serial.readStringUntil('"');
         newMessage.timeReceived = newMessage.timeReceived + "," + data;
-        Serial.read(); // "
-
-        #if defined( DEBUG_GSM )
-          if (myFile) {
-            myFile.print(data);
-            myFile.println(F("\""));
-          }
-        #endif
-        
-        data = Serial.readString();
+        serial.read(); // "
+        logger.print(data);
+        logger.println(F("\""));
+
+        newMessage.timestamp = GSM_parseTime(newMessage.timeReceived.c_str());
+
+        data = serial.readString();
         newMessage.content = data.substring(2, data.lastIndexOf("OK")-4);
+        logger.response(data, start);
 
-        #if defined( DEBUG_GSM )
-          if (myFile) {
-            myFile.println(newMessage.content);
-            long currentTime = millis();
-            myFile.println(F("OK"));
-            myFile.print(F("Time Taken (ms): "));
-            myFile.println(currentTime - start);
-          }
-        #endif
-
-        delay(500);
+        GSM_delay(500);
         return newMessage;
 
       }
@@ -1022,13 +1483,22 @@ SMS_Message GSM_A6::getSMS(uint8_t messageID) {
     }
   }
 
-  delay(500);
+  GSM_delay(500);
   return {};
 }
 
 
+/*
+  Deletes every message on the SIM Card, including messages which
+  haven't been processed yet, see deleteProcessedSMS().
+*/
 bool GSM_A6::deleteAllSMS() {
-  return sendAndWait("+CMGD=1,4");
+  if (!sendAndWait("+CMGD=1,4")) return false;
+  processedMessages = 0;
+  seenMessages = 0;
+  currentMessage = 0;
+  saveProcessedSMS();
+  return true;
 }
 
 /*
@@ -7,13 +7,50 @@
 	#include "WProgram.h"
 #endif
 
+// The host build in extras/host has no SD Card to log to
+#if !defined(GSM_HOST)
 #define DEBUG_GSM
+#endif
+
+// Uncomment to keep what the GSM has learnt (such as DNS results)
+// in EEPROM between resets, starting from this address
+//#define GSM_EEPROM_ADDRESS 0
+
+// Uncomment to upload files from the SD Card, see sendFile()
+//#define GSM_SD_SUPPORT
+
+// Uncomment to let a GSM_VirtualClock stand in for millis() and delay(),
+// so simulations run without waiting, see GSM_useClock()
+//#define GSM_VIRTUAL_CLOCK
 
-#if defined(DEBUG_GSM)
-	#include <SdFat.h>
-	#include <SPI.h>
+#if defined(DEBUG_GSM) && !defined(GSM_SD_SUPPORT)
+  #define GSM_SD_SUPPORT // The SD Card is already used by the log
 #endif
 
+#if defined(GSM_SD_SUPPORT)
+  #include <SdFat.h>
+#endif
+
+#if defined(GSM_EEPROM_ADDRESS)
+  #define GSM_EEPROM_DNS GSM_EEPROM_ADDRESS             // 17 bytes
+  #define GSM_EEPROM_TIMEOUTS (GSM_EEPROM_ADDRESS + 17) // 71 bytes, 7 for each of the 10 timeouts
+  #define GSM_EEPROM_SMS (GSM_EEPROM_ADDRESS + 88)      // 5 bytes
+  #define GSM_EEPROM_FIRMWARE (GSM_EEPROM_ADDRESS + 93) // 4 bytes
+  #define GSM_EEPROM_OPERATOR (GSM_EEPROM_ADDRESS + 97) // 9 bytes
+  #define GSM_EEPROM_USAGE (GSM_EEPROM_ADDRESS + 106)   // 24 bytes
+#endif
+
+#include "GSM_Clock.h"
+#include "GSM_Policy.h"
+#include "GSM_Response.h"
+#include "GSM_Dns.h"
+#include "GSM_Time.h"
+#include "GSM_Tx.h"
+#include "GSM_Timeouts.h"
+#include "GSM_Retry.h"
+#include "GSM_Firmware.h"
+#include "GSM_Usage.h"
+
 #define GSM_END "\r\n"
 #define GSM_OK "OK" + GSM_END
 #define GSM_ERROR "ERROR" + GSM_END;
@@ -22,13 +59,80 @@
 #define N_THREE 1
 #define N_ASDA 2
 
+// Longest response line kept from the GSM, longer lines are cut short
+#define GSM_RESPONSE_SIZE 64
+
+// Commands in a row without any reply before the GSM is reset, see recover()
+#define GSM_SILENT_LIMIT 3
+
+// Baud rates tried when the GSM can't be synced with in a debug build, see attemptAutoTune()
+#define GSM_BAUD_RATE_COUNT 10
+
 // Low the code number the greater the error
 enum CommandExectuionStatus : uint8_t {
   FATAL_ERROR = 0,  // Serve Error
   FAILED = 1,       // Minor Error
   SUCCESS = 2,
+  PENDING = 3,      // Still waiting for the response
+};
+
+// Operations which can be run in the background using poll()
+enum GSM_Operation : uint8_t {
+  GSM_NO_OPERATION = 0,
+  GSM_INIT = 1,
+  GSM_WAIT_FOR_NETWORK = 2,
+  GSM_CONNECT_TO_APN = 3,
+  GSM_GET_REQUEST = 4,
+  GSM_START_TCP_CONNECTION = 5,
+  GSM_SEND_FILE = 6,
+  GSM_RECOVER = 7,
+};
+
+// Counters kept since the GSM was created, times are in milliseconds
+struct GSM_Metrics {
+  uint16_t dnsHits;            // Connections made using a cached IP Address
+  uint16_t dnsMisses;          // Servers looked up by the GSM
+  uint16_t dnsFailures;        // Servers the GSM couldn't look up
+  uint16_t connectionsByIP;
+  uint16_t connectionsByName;
+  uint32_t connectTimeByIP;    // Total time to connect using an IP Address
+  uint32_t connectTimeByName;  // Total time to connect using the server name
+  uint32_t timeToRegister;     // Time the last waitForNetwork() took to register
+  uint16_t registrationsByCache; // Registrations after selecting the last operator, see useOperatorCache()
+  uint16_t registrationsByScan;
+  uint32_t registerTimeByCache;  // Total time to register after selecting the last operator
+  uint32_t registerTimeByScan;   // Total time to register with the GSM searching for an operator
+  uint32_t txTime;             // Total microseconds spent writing to the GSM
+  uint16_t recoveries;         // Times the GSM was reset after it stopped working
+  uint16_t failedRecoveries;   // Resets after which the GSM still didn't work
+  uint32_t recoveryTime;       // Total time to recover, divide by recoveries for the mean
+  uint16_t retries;            // Commands and requests tried again after failing
+  uint16_t rejectedRequests;   // Requests failed straight away as the circuit was open or over budget
+  uint32_t wakeTime;           // Time the last wake() took
+};
+
+// Registration status reported by +CREG, see getRegistration()
+enum Registration_Status : uint8_t {
+  NOT_REGISTERED       = 0, // Not searching for an operator
+  REGISTERED_HOME      = 1,
+  SEARCHING            = 2,
+  REGISTRATION_DENIED  = 3,
+  REGISTRATION_UNKNOWN = 4,
+  REGISTERED_ROAMING   = 5,
+};
+
+struct Network_Registration {
+  Registration_Status status;
+  uint16_t locationAreaCode;  // 0 when not known
+  uint16_t cellID;            // 0 when not known
+  unsigned long changedAt;    // millis() when the status last changed
 };
 
+class GSM_A6;
+
+// Called when a background operation finishes
+typedef void (*GSM_Callback)(GSM_A6 & gsm, GSM_Operation operation, bool success);
+
 enum Message_Status : uint8_t {
   READ = 0,
   UNREAD = 1,
@@ -38,10 +142,25 @@ struct SMS_Message {
   uint8_t id;
   Message_Status status;
   String timeReceived;
+  uint32_t timestamp; // timeReceived in seconds since 1970 UTC, 0 if not known
   String sender;
   String content;
 };
 
+// Called when a message starting with a command's keyword arrives. The sender and
+// the rest of the message after the keyword are only valid during the call.
+typedef void (*GSM_SmsHandler)(GSM_A6 & gsm, const char * sender, const char * arguments);
+
+/*
+  Command which can be sent to the GSM by SMS, see handleSMSCommands().
+  The table and the strings it points to must be stored in flash (PROGMEM).
+*/
+struct GSM_SmsCommand {
+  const char * keyword;                // Matched ignoring case
+  GSM_SmsHandler handler;
+  const char * const * allowedSenders; // Ends with NULL, NULL to allow anyone
+};
+
 enum Quality_Rating : uint8_t {
   EXCELLENT = 0,
   VERY_GOOD = 1,
@@ -56,11 +175,23 @@ enum Quality_Rating : uint8_t {
 
 class GSM_A6 {
 public:
+  // Pins are optional, -1 if the pin isn't connected
   GSM_A6();
+  GSM_A6(HardwareSerial & serial, int8_t resetPin = -1, int8_t powerPin = -1);
+  GSM_A6(Stream & serial, int8_t resetPin = -1, int8_t powerPin = -1);
+
+  bool setPower(bool isOn);
+  bool reset();
+  bool recover();
+  void useAutoRecovery(bool isEnabled);
 
   bool init();
   bool attemptSync(const String & username);
   bool attemptAutoTune();
+  bool useFlowControl(int8_t ctsPin, int8_t rtsPin = -1);
+  void useSleepPin(int8_t dtrPin);
+  bool sleep();
+  bool wake();
   bool setMobileNetwork(uint8_t networkProvider);
   bool connectToAPN(const String & apn, const String & username, const String & password);
 
@@ -68,18 +199,39 @@ public:
   Quality_Rating getSignalBitErrorRate();
   uint8_t getSignalStrengthRAW();
 
+  bool syncClock();
+  uint32_t getTime();
+
   bool getRequest(const String & server, const String & resource);
   bool startTCPConnection(const String & server);
+#if defined(GSM_SD_SUPPORT)
+  bool sendFile(const String & server, const String & resource, File & file, uint32_t & offset);
+#endif
   bool closeTCPConnection();
+  Print & getConnection();
+  void useDnsCache(bool isEnabled);
+  void useAdaptiveTimeouts(bool isEnabled);
+  void useOperatorCache(bool isEnabled);
+  const char * getOperator();
 
-  bool waitForNetwork(unsigned long timeout = 20000L);
+  const GSM_Metrics & getMetrics();
+  void printMetrics(Print & output);
+  GSM_RetryPolicy & getRetryPolicy();
+  const GSM_DataUsage & getDataUsage();
+  const GSM_DataUsage & getMonthlyDataUsage();
+  void setDataBudget(uint32_t bytes, uint16_t smsParts = 0);
+  const Network_Registration & getRegistration();
+  GSM_BringUp getBringUp();
+  bool isRegistered();
+
+  bool waitForNetwork(unsigned long timeout = 60000L);
   bool sendAndWait(const String & command, uint8_t repeatAmountOnMinorError = 2);
-  bool sendAndWait(const String & command, const String expected, uint8_t repeatAmountOnMinorError = 2);
+  bool sendAndWait(const String & command, const String expected, uint8_t repeatAmountOnMinorError = 2, unsigned long timeout = 15000L);
   uint8_t waitFor(const String expected = "OK", unsigned long timeout = 15000L);
   void sendCommand(const String & command);
   void sendAT();
 
-  void quickSMS(const String & phoneNo, const String & message);
+  bool quickSMS(const String & phoneNo, const String & message);
   bool startSMS();
   void enterSMSContent();
   void sendSMS();
@@ -96,6 +248,10 @@ public:
 	SMS_Message getSMS(uint8_t messageID);
   
   bool deleteAllSMS();
+  void markSMSProcessed(uint8_t messageID);
+  uint8_t deleteProcessedSMS();
+
+  uint8_t handleSMSCommands(const GSM_SmsCommand * commands, uint8_t count, bool deleteHandled = false);
 
   /* 
      Unstable not recommended to be used, would
@@ -105,24 +261,175 @@ public:
   //bool deleteSMS(uint8_t messageIndex);
   //bool deleteAllReadSMS();
 
-  #if defined( DEBUG_GSM )
-    void captureResponse(String &temp, long & start);
-    void stopDebugging();
-    void printDebugFile();
-  #endif
+  /*
+     Background versions of the methods above, these return straight away
+     and the operation is carried out by calling poll() from loop().
+     Only one operation can run at a time, the begin methods return false
+     if another operation is still running.
+  */
+  bool beginInit();
+  bool beginBringUp(const String & apn, const String & username, const String & password);
+  bool beginWaitForNetwork(unsigned long timeout = 60000L);
+  bool beginConnectToAPN(const String & apn, const String & username, const String & password);
+  bool beginGetRequest(const String & server, const String & resource);
+  bool beginRecover();
+  bool beginStartTCPConnection(const String & server);
+#if defined(GSM_SD_SUPPORT)
+  bool beginSendFile(const String & server, const String & resource, File & file, uint32_t & offset);
+#endif
+  bool poll();
+  bool isBusy();
+  void onComplete(GSM_Callback callback);
+
+  void captureResponse(String &temp, long & start);
+  void stopDebugging();
+  void printDebugFile();
 
 private:
-  //SoftwareSerial& serialA6;
+  Stream & serial;
+  HardwareSerial * hardwareSerial; // NULL when not a hardware port
+  static const uint32_t BAUD_RATES[GSM_BAUD_RATE_COUNT];
+  int8_t resetPin;
+  int8_t powerPin;
+  int8_t dtrPin;   // -1 if the GSM is woken by a command instead
+  bool isAsleep;
+  GSM_TxBuffer tx;
+
   uint8_t currentMessage;
   bool isSmsStorageSet;
+  uint32_t processedMessages; // Bit for each message index processed, see markSMSProcessed()
+  uint32_t seenMessages;      // Bit for each message read by handleSMSCommands() which isn't a command
 
   uint8_t getMessageID(const String & message);
+  bool getSignalQuality(uint8_t & strength, uint8_t & bitErrorRate);
+  bool listMessages(uint32_t & stored, uint32_t & unread);
+  void loadProcessedSMS();
+  void saveProcessedSMS();
+
+  // Response from the GSM
+  char response[GSM_RESPONSE_SIZE];
+  uint8_t responseLength;
+  bool isResponseCutShort; // The last line read was longer than GSM_RESPONSE_SIZE
+  const char * expected;
+  GSM_ResponseMatcher matcher;
+  GSM_Response responseType;
+  unsigned long responseStart;
+  unsigned long responseTimeout;
+  unsigned long fullTimeout;   // Timeout given for the response, before any adaptive timeout
+  uint16_t timedCommand; // Hash of the command being answered, 0 if not timed
+
+  void beginCommand(const String & command, const char * expected, unsigned long timeout);
+  void beginResponse(const char * expected, unsigned long timeout);
+  uint8_t pollResponse();
+  uint8_t checkResponse();
+  uint8_t completeResponse();
+  bool readLine(unsigned long timeout);
+  void discardInput();
+  void checkUnsolicited();
+  void readRegistration(const char * text);
+  bool readOperator(const char * text);
+  void loadOperator();
+  void saveOperator();
+  void checkHealth(uint8_t result, bool isProbe);
+  void learnTimeout(uint8_t result);
+  void classifyFailure(uint8_t result);
+  void learnBringUp(GSM_BringUp bringUp);
+  void countUsage();
+
+  // Background operations
+  enum Waiting : uint8_t {
+    NOT_WAITING,
+    WAITING_FOR_RESPONSE,
+    WAITING_FOR_RECOVERY, // Checking the GSM still responds after an error
+    WAITING_FOR_EVENT,    // Waiting for a report which may not arrive
+  };
+
+  GSM_Operation operation;
+  GSM_Callback callback;
+  Waiting waiting;
+  GSM_Operation bringUpTo;    // Last operation of a bring up, GSM_NO_OPERATION if not bringing up
+  bool isSuccessful;
+  uint8_t step;
+  uint8_t counter;
+  uint8_t baudAttempts;       // Baud rates tried by init() since it last synced, see attemptAutoTune()
+  uint8_t attempts;
+  uint8_t retries;
+  uint8_t requestAttempts;    // Times the current request has been made
+  uint8_t status;
+  unsigned long resumeAt;
+  unsigned long operationTimeout;
+  unsigned long operationStart;
+  String arguments[3];
+  String apnSettings[3];      // APN, username and password
+
+  // Health, see recover()
+  bool isSilent;              // Nothing received since the response began
+  uint8_t silentResponses;    // Commands in a row with no reply at all
+  bool isWedged;
+  bool isAutoRecoveryUsed;
+  bool isRecovering;
+  GSM_Operation sessionState; // Last bring up operation to succeed since the GSM was reset
+  unsigned long recoveryStart;
+
+  GSM_Metrics metrics;
+  Network_Registration registration;
+
+  // Operator, see useOperatorCache()
+  char operatorCode[7];     // Numeric code (MCC and MNC) of the last operator registered with, empty if not known
+  int8_t operatorTech;      // Access technology reported for it, -1 if not reported
+  bool isOperatorCacheUsed;
+  bool isOperatorSelected;  // The last operator was selected for the current registration
+
+  // Clock, see getTime()
+  uint32_t clockTime;          // Time of the last sync, 0 if never synced
+  unsigned long clockSyncedAt; // millis() of the last sync
+  int32_t clockDrift;          // Correction to millis() in parts per million
+
+  GSM_DnsCache dnsCache;
+  bool isDnsCacheUsed;
+
+  GSM_Timeouts timeouts;
+  bool isAdaptiveTimeoutUsed;
+
+  GSM_RetryPolicy retryPolicy;
+  bool isFailureFinal; // The last command failed in a way trying again won't fix
+
+  GSM_Usage usage;
+  uint32_t dataStart;  // tx.count() when the data being sent started, see getDataUsage()
+
+  GSM_Firmware firmware;
+  bool isIdentifying;  // Lines of the response are the reply to ATI
+
+#if defined(GSM_SD_SUPPORT)
+  // File being sent by sendFile()
+  File * file;
+  uint32_t * fileOffset;
+  uint32_t fileSize;
+  uint16_t blockLength; // Length of the block being sent, 0 if it couldn't be read
+#endif
+
+  bool beginOperation(GSM_Operation newOperation);
+  bool beginRequest(GSM_Operation newOperation);
+  bool runOperation();
+  void runStep();
+  void stepRecover();
+  void stepInit();
+  void stepWaitForNetwork();
+  void recordRegistration(bool isByCache);
+  void stepConnectToAPN();
+  void stepTCPConnection();
+#if defined(GSM_SD_SUPPORT)
+  void sendBlock();
+#endif
+  void command(const String & command, const char * expected = "OK", uint8_t repeatAmountOnMinorError = 2, unsigned long timeout = 15000L);
+  void expect(const char * expected, unsigned long timeout = 15000L);
+  void listen(const char * expected, unsigned long timeout);
+  void nextStep(unsigned long wait = 0);
+  void goToStep(uint8_t newStep, unsigned long wait = 0);
+  void finish(bool success);
+  bool retryRequest(bool success);
 
-  #if defined( DEBUG_GSM )
-    bool isDebugging;
-    File myFile;
-    SdFat SD;
-  #endif
+  GSM_Policy::Logger logger;
 };
 
 #endif
@@ -0,0 +1,55 @@
+#include "GSM_A6.h"
+
+#if defined(GSM_VIRTUAL_CLOCK)
+unsigned long GSM_Clock::millis() {
+  return ::millis();
+}
+
+unsigned long GSM_Clock::micros() {
+  return ::micros();
+}
+
+void GSM_Clock::delay(unsigned long time) {
+  ::delay(time);
+}
+
+static GSM_Clock arduinoClock;
+
+#if defined(GSM_HOST)
+thread_local GSM_Clock * GSM_clock = &arduinoClock;
+#else
+GSM_Clock * GSM_clock = &arduinoClock;
+#endif
+
+/*
+   Uses the clock for every GSM and GSM_Simulator from now on.
+   The clock must remain in memory while it is used. In the host
+   build this is only for GSMs used by the calling thread.
+ */
+void GSM_useClock(GSM_Clock & clock) {
+  GSM_clock = &clock;
+}
+
+GSM_VirtualClock::GSM_VirtualClock() : tick(100), now(0) { }
+
+unsigned long GSM_VirtualClock::millis() {
+  now += tick;
+  return now / 1000;
+}
+
+unsigned long GSM_VirtualClock::micros() {
+  now += tick;
+  return now;
+}
+
+void GSM_VirtualClock::delay(unsigned long time) {
+  advance(time);
+}
+
+/*
+   Moves the clock on by the given number of milliseconds.
+ */
+void GSM_VirtualClock::advance(unsigned long time) {
+  now += (uint64_t) time * 1000;
+}
+#endif
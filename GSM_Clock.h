@@ -0,0 +1,68 @@
+#ifndef _GSM_Clock_h
+#define _GSM_Clock_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+/*
+  Time used by the driver. GSM_millis(), GSM_micros() and GSM_delay()
+  are the Arduino functions unless GSM_VIRTUAL_CLOCK is defined in
+  GSM_A6.h, then they ask the clock given to GSM_useClock().
+*/
+
+#if defined(GSM_VIRTUAL_CLOCK)
+/*
+  Clock which can be replaced, by default it is the Arduino's own.
+*/
+class GSM_Clock {
+public:
+  virtual unsigned long millis();
+  virtual unsigned long micros();
+  virtual void delay(unsigned long time);
+};
+
+/*
+  Clock which only moves on when asked, so a simulation such as a
+  full bring up with GSM_Simulator runs in milliseconds while every
+  time the driver measures is still the time it would take on the
+  device. delay() moves the clock on straight away, and each read of
+  the clock moves it on by tick, so loops waiting for a reply or a
+  timeout get there.
+*/
+class GSM_VirtualClock : public GSM_Clock {
+public:
+  GSM_VirtualClock();
+
+  unsigned long millis();
+  unsigned long micros();
+  void delay(unsigned long time);
+  void advance(unsigned long time);
+
+  unsigned long tick; // Microseconds each read of the clock takes
+
+private:
+  uint64_t now; // Microseconds since the clock was created
+};
+
+// Each thread of the host build runs its own devices, so has its own clock
+#if defined(GSM_HOST)
+extern thread_local GSM_Clock * GSM_clock;
+#else
+extern GSM_Clock * GSM_clock;
+#endif
+
+void GSM_useClock(GSM_Clock & clock);
+
+inline unsigned long GSM_millis() { return GSM_clock->millis(); }
+inline unsigned long GSM_micros() { return GSM_clock->micros(); }
+inline void GSM_delay(unsigned long time) { GSM_clock->delay(time); }
+#else
+inline unsigned long GSM_millis() { return millis(); }
+inline unsigned long GSM_micros() { return micros(); }
+inline void GSM_delay(unsigned long time) { delay(time); }
+#endif
+
+#endif
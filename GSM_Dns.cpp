@@ -0,0 +1,130 @@
+#include "GSM_A6.h"
+
+#if defined(GSM_EEPROM_ADDRESS)
+  #include <EEPROM.h>
+#endif
+
+// Marks the cache as having been saved to EEPROM
+#define GSM_DNS_SAVED 0xD5
+
+GSM_DnsCache::GSM_DnsCache() : timeToLive(3600000L) {
+  clear();
+}
+
+/*
+  FNV-1a hash of the server name.
+*/
+uint32_t GSM_DnsCache::hash(const String & server) {
+  uint32_t result = 2166136261UL;
+  for (unsigned int i = 0; i < server.length(); ++i) {
+    result ^= (uint8_t) server.charAt(i);
+    result *= 16777619UL;
+  }
+  return result == 0 ? 1 : result;
+}
+
+int8_t GSM_DnsCache::indexOf(uint32_t server) {
+  for (uint8_t i = 0; i < GSM_DNS_CACHE_SIZE; ++i) {
+    if (entries[i].server == server) return i;
+  }
+  return -1;
+}
+
+/*
+  Looks up the IP Address of the server.
+
+  @param ip Set to the IP Address if it was found
+
+  @return true if the server was found and hasn't expired
+*/
+bool GSM_DnsCache::find(const String & server, uint8_t ip[4]) {
+  int8_t index = indexOf(hash(server));
+  if (index < 0) return false;
+
+  Entry & entry = entries[index];
+  if ((long) (GSM_millis() - entry.expiresAt) >= 0) {
+    entry.server = 0;
+    return false;
+  }
+
+  memcpy(ip, entry.ip, 4);
+  return true;
+}
+
+/*
+  Stores the IP Address of the server, replacing the
+  result closest to expiring if the cache is full.
+*/
+void GSM_DnsCache::store(const String & server, const uint8_t ip[4]) {
+  uint32_t serverHash = hash(server);
+  int8_t index = indexOf(serverHash);
+
+  if (index < 0) {
+    index = 0;
+    for (uint8_t i = 0; i < GSM_DNS_CACHE_SIZE; ++i) {
+      if (entries[i].server == 0) {
+        index = i;
+        break;
+      } else if ((long) (entries[i].expiresAt - entries[index].expiresAt) < 0) {
+        index = i;
+      }
+    }
+  }
+
+  Entry & entry = entries[index];
+  entry.server = serverHash;
+  memcpy(entry.ip, ip, 4);
+  entry.expiresAt = GSM_millis() + timeToLive;
+}
+
+/*
+  Forgets the IP Address of the server, used when it can't be connected to.
+*/
+void GSM_DnsCache::remove(const String & server) {
+  int8_t index = indexOf(hash(server));
+  if (index >= 0) entries[index].server = 0;
+}
+
+void GSM_DnsCache::clear() {
+  for (uint8_t i = 0; i < GSM_DNS_CACHE_SIZE; ++i) {
+    entries[i].server = 0;
+  }
+}
+
+/*
+  Loads results saved by save(), they are treated as new results
+  as the time they were looked up isn't known after a reset.
+*/
+void GSM_DnsCache::load(int address) {
+#if defined(GSM_EEPROM_ADDRESS)
+  if (EEPROM.read(address) != GSM_DNS_SAVED) return;
+
+  ++address;
+  for (uint8_t i = 0; i < GSM_DNS_CACHE_SIZE; ++i) {
+    Entry & entry = entries[i];
+    EEPROM.get(address, entry.server);
+    address += sizeof(entry.server);
+    for (uint8_t j = 0; j < 4; ++j) {
+      entry.ip[j] = EEPROM.read(address++);
+    }
+    entry.expiresAt = GSM_millis() + timeToLive;
+  }
+#endif
+}
+
+/*
+  Saves the results to EEPROM, only changed bytes are written.
+*/
+void GSM_DnsCache::save(int address) {
+#if defined(GSM_EEPROM_ADDRESS)
+  EEPROM.update(address++, GSM_DNS_SAVED);
+  for (uint8_t i = 0; i < GSM_DNS_CACHE_SIZE; ++i) {
+    Entry & entry = entries[i];
+    EEPROM.put(address, entry.server);
+    address += sizeof(entry.server);
+    for (uint8_t j = 0; j < 4; ++j) {
+      EEPROM.update(address++, entry.ip[j]);
+    }
+  }
+#endif
+}
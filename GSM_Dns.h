@@ -0,0 +1,45 @@
+#ifndef _GSM_Dns_h
+#define _GSM_Dns_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#define GSM_DNS_CACHE_SIZE 2
+
+/*
+  Remembers the IP Address of recently used servers, so connections
+  can be made without the GSM looking the server up each time.
+  Only a hash of the server name is kept to save RAM.
+*/
+class GSM_DnsCache {
+public:
+  GSM_DnsCache();
+
+  bool find(const String & server, uint8_t ip[4]);
+  void store(const String & server, const uint8_t ip[4]);
+  void remove(const String & server);
+  void clear();
+
+  void load(int address);
+  void save(int address);
+
+  // Time in milliseconds a result is used for before looking it up again
+  unsigned long timeToLive;
+
+private:
+  struct Entry {
+    uint32_t server;         // Hash of the server name, 0 if empty
+    uint8_t ip[4];
+    unsigned long expiresAt; // millis()
+  };
+
+  Entry entries[GSM_DNS_CACHE_SIZE];
+
+  static uint32_t hash(const String & server);
+  int8_t indexOf(uint32_t server);
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "GSM_A6.h"
+
+#if defined(GSM_EEPROM_ADDRESS)
+  #include <EEPROM.h>
+#endif
+
+// Marks the firmware as having been saved to EEPROM
+#define GSM_FIRMWARE_SAVED 0x3C
+
+GSM_Firmware::GSM_Firmware() : identity(0), pending(0), bringUp(GSM_BRING_UP_UNKNOWN), isIdentified(false) { }
+
+/*
+  Starts a new identity, each line of the reply to ATI is then given to addIdentity().
+*/
+void GSM_Firmware::beginIdentity() {
+  pending = 0x811C;
+  isIdentified = false;
+}
+
+/*
+  Adds a line of the reply to ATI to the identity. Reports such as
+  +CREG can arrive at any time, so lines starting with '+' are skipped.
+*/
+void GSM_Firmware::addIdentity(const char * line) {
+  if (*line == '+') return;
+  // FNV-1a using 16 bit arithmetic
+  while (*line != '\0') {
+    pending = (pending ^ (uint8_t) *line++) * 0x0193;
+  }
+  pending = (pending ^ '\n') * 0x0193;
+}
+
+/*
+  Finishes the identity started by beginIdentity(), the bring up is
+  forgotten if the firmware isn't the one it was found out for.
+
+  @param isIdentified false if the GSM didn't reply to ATI, the bring up is
+                      then found out again as the firmware isn't known
+
+  @return true if the identity changed and is worth saving
+*/
+bool GSM_Firmware::endIdentity(bool isIdentified) {
+  this->isIdentified = isIdentified;
+  if (!isIdentified || pending == identity) return false;
+
+  identity = pending == 0 ? 1 : pending;
+  bringUp = GSM_BRING_UP_UNKNOWN;
+  return true;
+}
+
+/*
+  @return the bring up the firmware needs, GSM_BRING_UP_UNKNOWN if it hasn't
+          been found out or the GSM hasn't been identified since it was reset
+*/
+GSM_BringUp GSM_Firmware::getBringUp() {
+  return isIdentified ? bringUp : GSM_BRING_UP_UNKNOWN;
+}
+
+/*
+  Records the bring up found out for the firmware, GSM_BRING_UP_UNKNOWN
+  to find it out again the next time.
+
+  @return true if it changed and is worth saving
+*/
+bool GSM_Firmware::setBringUp(GSM_BringUp bringUp) {
+  if (!isIdentified || bringUp == this->bringUp) return false;
+  this->bringUp = bringUp;
+  return true;
+}
+
+/*
+  @return the hash of the reply to ATI, 0 if the GSM has never been identified
+*/
+uint16_t GSM_Firmware::getIdentity() {
+  return identity;
+}
+
+/*
+  Loads the identity and bring up saved by save().
+*/
+void GSM_Firmware::load(int address) {
+#if defined(GSM_EEPROM_ADDRESS)
+  if (EEPROM.read(address) != GSM_FIRMWARE_SAVED) return;
+  EEPROM.get(address + 1, identity);
+  bringUp = (GSM_BringUp) EEPROM.read(address + 3);
+  if (bringUp > GSM_BRING_UP_CIICR) bringUp = GSM_BRING_UP_UNKNOWN;
+#endif
+}
+
+/*
+  Saves the identity and bring up to EEPROM, only changed bytes are written.
+*/
+void GSM_Firmware::save(int address) {
+#if defined(GSM_EEPROM_ADDRESS)
+  EEPROM.update(address, GSM_FIRMWARE_SAVED);
+  EEPROM.put(address + 1, identity);
+  EEPROM.update(address + 3, bringUp);
+#endif
+}
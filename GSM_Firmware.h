@@ -0,0 +1,46 @@
+#ifndef _GSM_Firmware_h
+#define _GSM_Firmware_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// How the firmware readies the internet connection after +CGACT, see GSM_Firmware
+enum GSM_BringUp : uint8_t {
+  GSM_BRING_UP_UNKNOWN = 0, // Found out with +CIPSTATUS while connecting
+  GSM_BRING_UP_GPRSACT = 1, // Older firmware, ready straight away (IP GPRSACT)
+  GSM_BRING_UP_CIICR   = 2, // Newer firmware, reports IP START and needs +CIICR
+};
+
+/*
+  Remembers which bring up the GSM's firmware needs, so connecting to
+  the APN doesn't have to ask +CIPSTATUS each time to find out. The
+  firmware is identified by a hash of its reply to ATI (manufacturer,
+  model and revision), and the bring up is found out again whenever
+  a different firmware replies.
+*/
+class GSM_Firmware {
+public:
+  GSM_Firmware();
+
+  void beginIdentity();
+  void addIdentity(const char * line);
+  bool endIdentity(bool isIdentified);
+
+  GSM_BringUp getBringUp();
+  bool setBringUp(GSM_BringUp bringUp);
+  uint16_t getIdentity();
+
+  void load(int address);
+  void save(int address);
+
+private:
+  uint16_t identity;  // Hash of the reply to ATI, 0 if not known
+  uint16_t pending;   // Hash of the reply so far
+  GSM_BringUp bringUp;
+  bool isIdentified;  // The GSM has replied with the identity since it was reset
+};
+
+#endif
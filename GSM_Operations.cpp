@@ -0,0 +1,1024 @@
+#include "GSM_A6.h"
+
+/*
+  Background operations. Each operation is split into steps, a step
+  sends one command and is run again once the response has arrived,
+  so nothing here waits for the GSM. The blocking methods such as
+  init() and getRequest() run these same steps until they finish.
+*/
+
+/*
+   Starts initialising the GSM in the background, see init().
+
+   @return false if another operation is still running
+ */
+bool GSM_A6::beginInit() {
+  if (!beginOperation(GSM_INIT)) return false;
+
+  loadProcessedSMS();
+  #if defined(GSM_EEPROM_ADDRESS)
+    firmware.load(GSM_EEPROM_FIRMWARE);
+    usage.load(GSM_EEPROM_USAGE);
+  #endif
+  logger.begin();
+  logger.println(F("Initailising GSM..."));
+  return true;
+}
+
+/*
+   Initialises the GSM, waits for the mobile network and then
+   connects to the APN in the background. The callback is only
+   called once, when the last of these finishes or one fails.
+
+   @return false if another operation is still running
+ */
+bool GSM_A6::beginBringUp(const String & apn, const String & username, const String & password) {
+  if (!beginInit()) return false;
+
+  apnSettings[0] = apn;
+  apnSettings[1] = username;
+  apnSettings[2] = password;
+  bringUpTo = GSM_CONNECT_TO_APN;
+  return true;
+}
+
+/*
+   Starts waiting for the mobile network in the background, see waitForNetwork().
+
+   @return false if another operation is still running
+ */
+bool GSM_A6::beginWaitForNetwork(unsigned long timeout) {
+  if (!beginOperation(GSM_WAIT_FOR_NETWORK)) return false;
+
+  operationTimeout = timeout;
+  operationStart = GSM_millis();
+  registration.status = REGISTRATION_UNKNOWN;
+  registration.changedAt = operationStart;
+  isOperatorSelected = false;
+  logger.println(F("Connecting To Network..."));
+  return true;
+}
+
+/*
+   Starts connecting to the APN in the background, see connectToAPN().
+
+   @return false if another operation is still running
+ */
+bool GSM_A6::beginConnectToAPN(const String & apn, const String & username, const String & password) {
+  if (!beginOperation(GSM_CONNECT_TO_APN)) return false;
+
+  // Kept so the connection can be made again by recover()
+  apnSettings[0] = apn;
+  apnSettings[1] = username;
+  apnSettings[2] = password;
+  return true;
+}
+
+/*
+   Starts a get request in the background, see getRequest().
+
+   @return false if another operation is still running, or the
+           circuit is open as requests keep failing, see GSM_RetryPolicy
+ */
+bool GSM_A6::beginGetRequest(const String & server, const String & resource) {
+  if (!beginRequest(GSM_GET_REQUEST)) return false;
+
+  arguments[0] = server;
+  arguments[1] = resource;
+  logger.println(F("Making Get Request..."));
+  return true;
+}
+
+/*
+   Starts connecting to the server in the background, see startTCPConnection().
+
+   @return false if another operation is still running or the circuit is open
+ */
+bool GSM_A6::beginStartTCPConnection(const String & server) {
+  if (!beginRequest(GSM_START_TCP_CONNECTION)) return false;
+
+  arguments[0] = server;
+  logger.println(F("Making Get Request..."));
+  return true;
+}
+
+#if defined(GSM_SD_SUPPORT)
+/*
+   Starts sending a file in the background, see sendFile().
+   The file and offset must remain in memory until the operation finishes.
+
+   @return false if another operation is still running or the circuit is open
+ */
+bool GSM_A6::beginSendFile(const String & server, const String & resource, File & file, uint32_t & offset) {
+  if (!beginRequest(GSM_SEND_FILE)) return false;
+
+  arguments[0] = server;
+  arguments[1] = resource;
+  this->file = &file;
+  fileOffset = &offset;
+  fileSize = file.size();
+  logger.println(F("Sending File..."));
+
+  // An empty file, or one already sent, has no range to send
+  if (offset >= fileSize) {
+    logger.println(F("Success - Nothing Left to Send"));
+    finish(true);
+  }
+  return true;
+}
+#endif
+
+/*
+   Starts recovering the GSM in the background, see recover().
+
+   @return false if another operation is running or there are no pins to reset the GSM
+ */
+bool GSM_A6::beginRecover() {
+  if (resetPin < 0 && powerPin < 0) return false;
+  if (!beginOperation(GSM_RECOVER)) return false;
+
+  isRecovering = true;
+  recoveryStart = GSM_millis();
+  bringUpTo = sessionState > GSM_INIT ? sessionState : GSM_INIT;
+  sessionState = GSM_NO_OPERATION;
+  logger.println(F("Recovering GSM..."));
+  return true;
+}
+
+/*
+   Carries on with the current background operation without waiting,
+   should be called frequently from loop().
+
+   @return true while an operation is still running
+ */
+bool GSM_A6::poll() {
+  if (operation == GSM_NO_OPERATION) return false;
+
+  if (waiting != NOT_WAITING) {
+    uint8_t result = pollResponse();
+    if (result == PENDING) return true;
+
+    if (waiting == WAITING_FOR_RESPONSE && result == FAILED) {
+      checkHealth(result, false);
+      learnTimeout(result);
+      classifyFailure(result);
+
+      // Minor error, check the GSM is listening before carrying on.
+      // Status stays PENDING if the command should be sent again,
+      // which it is once the back-off has passed.
+      if (++attempts >= retries || isFailureFinal) {
+        status = FAILED;
+      } else {
+        ++metrics.retries;
+        resumeAt = GSM_millis() + retryPolicy.backoff(attempts);
+      }
+      sendAT();
+      beginResponse("OK", 1000);
+      waiting = WAITING_FOR_RECOVERY;
+      return true;
+    }
+
+    if (waiting != WAITING_FOR_EVENT) checkHealth(result, waiting == WAITING_FOR_RECOVERY);
+    if (waiting == WAITING_FOR_RESPONSE) {
+      learnTimeout(result);
+      classifyFailure(result);
+    }
+    if (waiting != WAITING_FOR_RECOVERY) status = result;
+    waiting = NOT_WAITING;
+  }
+
+  if ((long) (GSM_millis() - resumeAt) < 0) return true;
+
+  runStep();
+  return operation != GSM_NO_OPERATION;
+}
+
+/*
+   @return true if a background operation is running
+ */
+bool GSM_A6::isBusy() {
+  return operation != GSM_NO_OPERATION;
+}
+
+/*
+   Sets the function to call when a background operation finishes.
+ */
+void GSM_A6::onComplete(GSM_Callback callback) {
+  this->callback = callback;
+}
+
+/*
+   Starts an operation which makes a request to a server,
+   unless requests are failing straight away, see GSM_RetryPolicy.
+ */
+bool GSM_A6::beginRequest(GSM_Operation newOperation) {
+  if (operation != GSM_NO_OPERATION) return false;
+
+  if (retryPolicy.isOpen()) {
+    ++metrics.rejectedRequests;
+    logger.println(F("Failed - Circuit Open"));
+    return false;
+  }
+  if (usage.isOverBudget(false)) {
+    ++metrics.rejectedRequests;
+    logger.println(F("Failed - Data Budget"));
+    return false;
+  }
+
+  requestAttempts = 0;
+  return beginOperation(newOperation);
+}
+
+bool GSM_A6::beginOperation(GSM_Operation newOperation) {
+  if (operation != GSM_NO_OPERATION) return false;
+
+  operation = newOperation;
+  counter = 0;
+  baudAttempts = 0;
+  waiting = NOT_WAITING;
+  isIdentifying = false;
+  goToStep(0);
+  return true;
+}
+
+/*
+   Runs the current operation until it has finished.
+
+   @return true if the operation was successful
+ */
+bool GSM_A6::runOperation() {
+  while (poll()) { }
+  return isSuccessful;
+}
+
+void GSM_A6::runStep() {
+  switch (operation) {
+    case GSM_RECOVER:
+      stepRecover();
+      break;
+    case GSM_INIT:
+      stepInit();
+      break;
+    case GSM_WAIT_FOR_NETWORK:
+      stepWaitForNetwork();
+      break;
+    case GSM_CONNECT_TO_APN:
+      stepConnectToAPN();
+      break;
+    case GSM_GET_REQUEST:
+    case GSM_START_TCP_CONNECTION:
+    case GSM_SEND_FILE:
+      stepTCPConnection();
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+   Sends a command as part of the current step, the step is run
+   again with the status once the response arrives.
+ */
+void GSM_A6::command(const String & command, const char * expected, uint8_t repeatAmountOnMinorError, unsigned long timeout) {
+  beginCommand(command, expected, timeout);
+  retries = repeatAmountOnMinorError;
+  waiting = WAITING_FOR_RESPONSE;
+}
+
+/*
+   Waits for a response without sending a command as part of the current step.
+ */
+void GSM_A6::expect(const char * expected, unsigned long timeout) {
+  beginResponse(expected, timeout);
+  retries = 1;
+  waiting = WAITING_FOR_RESPONSE;
+}
+
+/*
+   Waits for a report from the GSM as part of the current step, the
+   step is run again with FAILED if it doesn't arrive in time.
+ */
+void GSM_A6::listen(const char * expected, unsigned long timeout) {
+  beginResponse(expected, timeout);
+  waiting = WAITING_FOR_EVENT;
+}
+
+void GSM_A6::nextStep(unsigned long wait) {
+  goToStep(step + 1, wait);
+}
+
+/*
+   Moves to the given step, which will be run after waiting
+   the given number of milliseconds.
+ */
+void GSM_A6::goToStep(uint8_t newStep, unsigned long wait) {
+  step = newStep;
+  status = PENDING;
+  attempts = 0;
+  resumeAt = GSM_millis() + wait;
+}
+
+/*
+   Makes the request again after it fails, waiting as given by the retry
+   policy. Requests aren't made again after errors which won't go away
+   or when the GSM has stopped working, recovery takes over instead.
+
+   @return true if the request is being made again
+ */
+bool GSM_A6::retryRequest(bool success) {
+  if (operation != GSM_GET_REQUEST && operation != GSM_START_TCP_CONNECTION && operation != GSM_SEND_FILE) {
+    return false;
+  }
+
+  if (success) {
+    retryPolicy.succeeded();
+    return false;
+  }
+
+  if (++requestAttempts >= retryPolicy.requestAttempts || isFailureFinal || isWedged) {
+    retryPolicy.failed();
+    return false;
+  }
+
+  ++metrics.retries;
+  logger.println(F("Retrying request..."));
+  counter = 0;
+  if (step == 5 && status != SUCCESS) {
+    // The request has been sent and only closing failed, so only close again
+    goToStep(5, retryPolicy.backoff(requestAttempts));
+  } else {
+    // Close the connection first if it was made and not already closed
+    goToStep(step >= 3 && step != 5 ? 8 : 0, retryPolicy.backoff(requestAttempts));
+  }
+  return true;
+}
+
+void GSM_A6::finish(bool success) {
+  if (retryRequest(success)) return;
+
+  GSM_Operation finished = operation;
+  operation = GSM_NO_OPERATION;
+
+  if (success && finished == GSM_INIT) {
+    sessionState = GSM_INIT;
+  } else if (success && finished <= GSM_CONNECT_TO_APN && finished > sessionState) {
+    sessionState = finished;
+  }
+
+  if (bringUpTo != GSM_NO_OPERATION && success) {
+    if (finished == GSM_RECOVER) {
+      beginOperation(GSM_INIT);
+      return;
+    } else if (finished == GSM_INIT && bringUpTo > GSM_INIT) {
+      beginWaitForNetwork();
+      return;
+    } else if (finished == GSM_WAIT_FOR_NETWORK && bringUpTo > GSM_WAIT_FOR_NETWORK) {
+      beginConnectToAPN(apnSettings[0], apnSettings[1], apnSettings[2]);
+      resumeAt += 1000;
+      return;
+    }
+  }
+
+  bringUpTo = GSM_NO_OPERATION;
+
+  if (isRecovering) {
+    // The whole bring up is reported as recovering
+    isRecovering = false;
+    isWedged = false;
+    silentResponses = 0;
+    finished = GSM_RECOVER;
+
+    if (success) {
+      ++metrics.recoveries;
+      metrics.recoveryTime += GSM_millis() - recoveryStart;
+      logger.println(F("Success - Recovered"));
+    } else {
+      ++metrics.failedRecoveries;
+      logger.println(F("Failed - Recovery"));
+    }
+  } else {
+    isSuccessful = success;
+  }
+
+  if (callback) callback(*this, finished, success);
+
+  if (!success && isWedged && isAutoRecoveryUsed && finished != GSM_RECOVER) {
+    beginRecover();
+  }
+}
+
+/*
+   Resets the GSM with the reset pin, or switches it off and on
+   if there is only a power pin. finish() then brings it back up.
+ */
+void GSM_A6::stepRecover() {
+  switch (step) {
+    case 0:
+      if (resetPin >= 0) {
+        pinMode(resetPin, OUTPUT);
+        digitalWrite(resetPin, HIGH);
+        nextStep(2000);
+      } else {
+        pinMode(powerPin, OUTPUT);
+        digitalWrite(powerPin, LOW);
+        nextStep(1000);
+      }
+      discardInput();
+      break;
+
+    case 1:
+      digitalWrite(resetPin >= 0 ? resetPin : powerPin, resetPin >= 0 ? LOW : HIGH);
+      discardInput();
+      nextStep(6000); // Give the GSM sufficient time to reinitialise
+      break;
+
+    default:
+      finish(true);
+      break;
+  }
+}
+
+void GSM_A6::stepInit() {
+  switch (step) {
+    case 0: // Repeatedly send AT so the GSM can sync to the baud rate
+      tx.print(F("AT"));
+      tx.print(GSM_END);
+      tx.send();
+      if (++counter < 20) {
+        goToStep(0, 40);
+      } else {
+        counter = 0;
+        nextStep(50);
+      }
+      break;
+
+    case 1: // The GSM needs to respond to two AT commands in a row
+    case 2:
+      if (status == PENDING) {
+        command("", "OK", 1, 150);
+      } else if (status == SUCCESS) {
+        nextStep(step == 1 ? 50 : 0);
+      } else if (++counter < 10) {
+        goToStep(1, 50);
+      } else if (GSM_Policy::AUTO_TUNE && hardwareSerial != NULL && baudAttempts < 2 * GSM_BAUD_RATE_COUNT - 1) {
+        goToStep(11);
+      } else {
+        if (baudAttempts > 0) {
+          hardwareSerial->begin(9600);
+          logger.println(F("Baud Rate not Found"));
+        }
+        finish(false);
+      }
+      break;
+
+    case 3:
+      if (baudAttempts > 0) {
+        logger.println(F("Baud Rate Found at: "));
+        logger.println(pgm_read_dword(&BAUD_RATES[baudAttempts % GSM_BAUD_RATE_COUNT]));
+      }
+      logger.println(F("Success - In Sync"));
+      logger.println(F("Preparing"));
+      nextStep();
+      break;
+
+    case 6: // Identify the firmware, once echo is off so only the reply is read
+      if (status == PENDING) {
+        firmware.beginIdentity();
+        isIdentifying = true;
+        command(F("I"));
+      } else {
+        isIdentifying = false;
+        if (firmware.endIdentity(status == SUCCESS)) {
+          logger.println(F("New firmware, bring up will be found out again"));
+          #if defined(GSM_EEPROM_ADDRESS)
+            firmware.save(GSM_EEPROM_FIRMWARE);
+          #endif
+        }
+        nextStep();
+      }
+      break;
+
+    case 11: // Try the next baud rate, twice through them all, and sync again
+      ++baudAttempts;
+      hardwareSerial->flush();
+      hardwareSerial->begin(pgm_read_dword(&BAUD_RATES[baudAttempts % GSM_BAUD_RATE_COUNT]));
+      counter = 0;
+      goToStep(0);
+      break;
+
+    default: // Configure the GSM, errors are ignored
+      if (status != PENDING) {
+        if (step == 10) {
+          finish(true);
+        } else {
+          nextStep();
+        }
+      } else if (step == 4) {
+        command(F("&F0")); // Reset Settings
+      } else if (step == 5) {
+        command(F("E0")); // disable Echo
+      } else if (step == 7) {
+        command(F("+CMEE=2")); // enable better error messages
+      } else if (step == 8) {
+        command(F("+CPMS=\"SM\",\"SM\",\"SM\"")); // Set SMS Storage for 3 memory areas
+      } else if (step == 9) {
+        command(F("+CMGF=1"));
+      } else {
+        command(F("+CTZU=1")); // Let the network update the clock and time zone
+      }
+      break;
+  }
+}
+
+/*
+   Turns on +CREG reports and asks for the registration. If the GSM isn't
+   already registered the last operator is selected if known, see
+   useOperatorCache(), then it waits for the GSM to report a change.
+   The registration is asked for again if nothing is reported, waiting
+   twice as long each time up to 16 seconds. Once registered the
+   operator is asked for, to select it next time.
+ */
+void GSM_A6::stepWaitForNetwork() {
+  unsigned long elapsed = GSM_millis() - operationStart;
+
+  if (step < 6 && isRegistered()) {
+    metrics.timeToRegister = elapsed;
+    logger.println(F("Success - Connected"));
+
+    if (!isOperatorCacheUsed) {
+      recordRegistration(false);
+      finish(true);
+      return;
+    }
+    goToStep(6);
+  }
+
+  if (step < 6 && elapsed >= operationTimeout) {
+    logger.println(F("Failed - Not Connected"));
+    finish(false);
+    return;
+  }
+
+  unsigned long remaining = step < 6 ? operationTimeout - elapsed : 0;
+
+  switch (step) {
+    case 0: // Report changes along with the location, the GSM can still be asked if not supported
+      if (status == PENDING) {
+        command(F("+CREG=2"), "OK", 1, min(remaining, 5000UL));
+      } else {
+        nextStep();
+      }
+      break;
+
+    case 1: // If already registered the operator isn't selected, as that could make the GSM register again
+      if (status == PENDING) {
+        command(F("+CREG?"), "+CREG:", 1, min(remaining, 5000UL));
+      } else {
+        nextStep();
+      }
+      break;
+
+    case 2: // Manual selection of the last operator, falling back to automatic if it fails
+      if (!isOperatorCacheUsed || operatorCode[0] == '\0') {
+        goToStep(5);
+      } else if (status == PENDING) {
+        String selection = "+COPS=4,2,\"" + String(operatorCode) + '"';
+        if (operatorTech >= 0) selection += "," + String(operatorTech);
+        command(selection, "OK", 1, min(remaining, 60000UL));
+      } else if (status == SUCCESS) {
+        isOperatorSelected = true;
+        goToStep(4);
+      } else {
+        logger.println(F("Failed - Select Operator"));
+        nextStep();
+      }
+      break;
+
+    case 3: // Make sure the GSM searches every operator, errors are ignored
+      if (status == PENDING) {
+        command(F("+COPS=0"), "OK", 1, min(remaining, 60000UL));
+      } else {
+        nextStep();
+      }
+      break;
+
+    case 4:
+      if (status == PENDING) {
+        command(F("+CREG?"), "+CREG:", 1, min(remaining, 5000UL));
+      } else {
+        nextStep();
+      }
+      break;
+
+    case 5: // Wait for a report
+      if (status == PENDING) {
+        listen("+CREG:", min(remaining, 1000UL << counter));
+      } else if (status == SUCCESS) {
+        goToStep(5); // Still searching
+      } else {
+        if (counter < 4) ++counter;
+        goToStep(4);
+      }
+      break;
+
+    case 6: // Ask for the operator by its numeric code, errors are ignored as already registered
+      if (status == PENDING) {
+        command(F("+COPS=3,2"), "OK", 1, 5000);
+      } else {
+        nextStep();
+      }
+      break;
+
+    case 7:
+      if (status == PENDING) {
+        command(F("+COPS?"), "+COPS:", 1, 5000);
+      } else {
+        // Only registered by the cache if it was the operator selected
+        bool isChanged = status == SUCCESS && readOperator(response + 6);
+        recordRegistration(isOperatorSelected && !isChanged);
+        finish(true);
+      }
+      break;
+  }
+}
+
+void GSM_A6::recordRegistration(bool isByCache) {
+  if (isByCache) {
+    ++metrics.registrationsByCache;
+    metrics.registerTimeByCache += metrics.timeToRegister;
+  } else {
+    ++metrics.registrationsByScan;
+    metrics.registerTimeByScan += metrics.timeToRegister;
+  }
+}
+
+void GSM_A6::stepConnectToAPN() {
+  switch (step) {
+    case 0:
+      if (!GSM_Policy::DIAGNOSTICS) {
+        nextStep();
+      } else if (status == PENDING) {
+        // Get network status for debugging
+        logger.println(F("Getting Network Status:"));
+        command(F("+CIPSTATUS"), "IP INITIAL");
+      } else {
+        nextStep();
+      }
+      break;
+
+    case 1: //Attach Network - Page 133 & 136
+      if (status == PENDING) {
+        command(F("+CGATT=1"), "OK", 4);
+      } else if (status == SUCCESS) {
+        nextStep(1000);
+      } else {
+        logger.println(F("Failed - Attach Network"));
+        finish(false);
+      }
+      break;
+
+    case 2:
+      if (!GSM_Policy::DIAGNOSTICS) {
+        nextStep();
+      } else if (status == PENDING) {
+        // Attach status for debugging, the bring up carries on either way
+        command(F("+CGATT?"), "OK", 4);
+      } else {
+        if (status != SUCCESS) logger.println(F("Unknown - Attach Status"));
+        nextStep();
+      }
+      break;
+
+    case 3: // Define PDP Context page 134
+      if (status == PENDING) {
+        command("+CGDCONT=1,\"IP\",\"" + apnSettings[0] + "\"");
+      } else if (status == SUCCESS) {
+        nextStep(1000);
+      } else {
+        logger.println(F("Failed - Define PDP Context"));
+        finish(false);
+      }
+      break;
+
+    case 4: //Set APN Details - Page 159
+      if (status == PENDING) {
+        command("+CSTT=\"" + apnSettings[0] + "\",\"" + apnSettings[1] + "\",\"" + apnSettings[2] + "\"");
+      } else if (status == SUCCESS) {
+        nextStep(1500);
+      } else {
+        logger.println(F("Failed - Set APN Settings"));
+        finish(false);
+      }
+      break;
+
+    case 5: //Activate PDP Context - Page 136
+      if (status == PENDING) {
+        command(F("+CGACT=1,1"), "OK", 4);
+      } else if (status == SUCCESS) {
+        logger.println(F("Getting Network Status:"));
+        nextStep(1500);
+      } else {
+        logger.println(F("Failed - Activate PDP Context"));
+        logger.print(F("GSM couldn't be attached to the mobile network "));
+        logger.println(F("(check APN settings and SIM Card is activated)"));
+        finish(false);
+      }
+      break;
+
+    case 6: // Check for older version first, as the GSM will then be quicker in the field
+      if (firmware.getBringUp() == GSM_BRING_UP_GPRSACT) {
+        goToStep(9); // Already found out for this firmware, see getBringUp()
+      } else if (firmware.getBringUp() == GSM_BRING_UP_CIICR) {
+        goToStep(8);
+      } else if (status == PENDING) {
+        command(F("+CIPSTATUS"), "IP GPRSACT");
+      } else if (status == SUCCESS) {
+        learnBringUp(GSM_BRING_UP_GPRSACT);
+        goToStep(9);
+      } else {
+        nextStep();
+      }
+      break;
+
+    case 7: // The new version of the GSM A6 returns IP START here
+      if (status == PENDING) {
+        command(F("+CIPSTATUS"), "IP START");
+      } else if (status == SUCCESS) {
+        logger.println(F("Newer Version of GSM Detected, Firmware needs flash back"));
+        learnBringUp(GSM_BRING_UP_CIICR);
+        nextStep();
+      } else {
+        goToStep(9);
+      }
+      break;
+
+    case 8: // And it requires and additional command to ready the internet connection
+      if (status == PENDING) {
+        command(F("+CIICR"), "OK", 4);
+      } else if (status == SUCCESS) {
+        nextStep(2000);
+      } else {
+        learnBringUp(GSM_BRING_UP_UNKNOWN); // Find it out again next time in case it was wrong
+        finish(false);
+      }
+      break;
+
+    case 9: //Get IP Address - Page 161
+      if (status == PENDING) {
+        command(F("+CIFSR"), "OK", 4);
+      } else if (status == SUCCESS) {
+        nextStep();
+      } else {
+        logger.println(F("Failed - Get IP"));
+        learnBringUp(GSM_BRING_UP_UNKNOWN);
+        finish(false);
+      }
+      break;
+
+    case 10:
+      if (GSM_Policy::DIAGNOSTICS && status == PENDING) {
+        // Connection status for debugging, the bring up has already succeeded
+        command(F("+CIPSTATUS"), "OK", 4);
+      } else {
+        logger.println(F("Success - APN Connection"));
+        finish(true);
+      }
+      break;
+  }
+}
+
+/*
+   Reads an IP Address such as 192.168.0.1 from the text.
+
+   @return true if a complete IP Address was read
+ */
+static bool readIPAddress(const char * text, uint8_t ip[4]) {
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!isDigit(*text)) return false;
+    ip[i] = atoi(text);
+    while (isDigit(*text)) ++text;
+    if (i < 3 && *text++ != '.') return false;
+  }
+  return true;
+}
+
+static String toString(const uint8_t ip[4]) {
+  return String(ip[0]) + '.' + String(ip[1]) + '.' + String(ip[2]) + '.' + String(ip[3]);
+}
+
+/*
+   Steps of getRequest(), startTCPConnection() and sendFile(). The server is arguments[0],
+   arguments[2] is the server name or IP Address used to connect.
+ */
+void GSM_A6::stepTCPConnection() {
+  uint8_t ip[4];
+
+  switch (step) {
+    case 0: // Use the IP Address from the cache if possible
+      arguments[2] = arguments[0];
+      if (!isDnsCacheUsed || readIPAddress(arguments[0].c_str(), ip)) {
+        goToStep(2);
+      } else if (dnsCache.find(arguments[0], ip)) {
+        ++metrics.dnsHits;
+        arguments[2] = toString(ip);
+        goToStep(2);
+      } else {
+        nextStep();
+      }
+      break;
+
+    case 1: // Look up the server, +CDNSGIP: 1,"<server>","<IP Address>"
+      if (status == PENDING) {
+        command("+CDNSGIP=\"" + arguments[0] + "\"", "+CDNSGIP:", 1);
+        break;
+      }
+
+      if (status == SUCCESS) {
+        const char * lastQuote = strrchr(response, '"');
+        const char * address = lastQuote;
+        while (address > response && *(address - 1) != '"') --address;
+
+        if (lastQuote != NULL && readIPAddress(address, ip)) {
+          ++metrics.dnsMisses;
+          dnsCache.store(arguments[0], ip);
+          #if defined(GSM_EEPROM_ADDRESS)
+            dnsCache.save(GSM_EEPROM_DNS);
+          #endif
+          arguments[2] = toString(ip);
+          nextStep();
+          break;
+        }
+      }
+
+      // Let the GSM look up the server while connecting instead
+      ++metrics.dnsFailures;
+      nextStep();
+      break;
+
+    case 2:
+      if (status == PENDING) {
+        operationStart = GSM_millis();
+        command("+CIPSTART=\"TCP\",\"" + arguments[2] + "\",80");
+      } else if (status == SUCCESS) {
+        usage.addConnection();
+        countUsage();
+        nextStep(150);
+      } else if (arguments[2] != arguments[0] && counter == 0) {
+        // The IP Address may have changed, look the server up again
+        ++counter;
+        dnsCache.remove(arguments[0]);
+        goToStep(1);
+      } else {
+        logger.println(F("Failed"));
+        finish(false);
+      }
+      break;
+
+    case 3:
+      if (status == PENDING) {
+        command(F("+CIPSEND"), ">");
+      } else if (status != SUCCESS) {
+        finish(false);
+      } else {
+        if (arguments[2] == arguments[0]) {
+          ++metrics.connectionsByName;
+          metrics.connectTimeByName += GSM_millis() - operationStart;
+        } else {
+          ++metrics.connectionsByIP;
+          metrics.connectTimeByIP += GSM_millis() - operationStart;
+        }
+
+        dataStart = tx.count();
+        if (operation == GSM_START_TCP_CONNECTION) {
+          finish(true);
+          break;
+        }
+
+        tx.print(operation == GSM_GET_REQUEST ? F("GET ") : F("POST "));
+        tx.print(arguments[1]);
+        tx.print(F(" HTTP/1.1\r\n"));
+        tx.print(F("Host: "));
+        tx.print(arguments[0]);
+#if defined(GSM_SD_SUPPORT)
+        if (operation == GSM_SEND_FILE) {
+          tx.print(F("\r\nContent-Type: application/octet-stream"));
+          tx.print(F("\r\nContent-Range: bytes "));
+          tx.print(*fileOffset);
+          tx.print('-');
+          tx.print(fileSize - 1);
+          tx.print('/');
+          tx.print(fileSize);
+          tx.print(F("\r\nContent-Length: "));
+          tx.print(fileSize - *fileOffset);
+        }
+#endif
+        tx.print(F("\r\nConnection: close\r\n\r\n"));
+        usage.addSent(tx.count() - dataStart);
+        countUsage();
+        tx.write(0x1A);
+        tx.send();
+        nextStep();
+      }
+      break;
+
+    case 4: // Wait for the data to be sent
+      if (status == PENDING) {
+        expect("OK");
+      } else {
+        if (status == SUCCESS) {
+          logger.println(F("Success - Waiting"));
+        } else {
+          logger.println(F("Failed - Waiting"));
+        }
+        goToStep(operation == GSM_SEND_FILE && status == SUCCESS ? 6 : 5);
+      }
+      break;
+
+    case 5: // Close connection
+      if (status == PENDING) {
+        command(F("+CIPCLOSE"));
+      } else if (status == SUCCESS) {
+        logger.println(F("Success - Connection Closed"));
+#if defined(GSM_SD_SUPPORT)
+        if (operation == GSM_SEND_FILE) {
+          finish(*fileOffset >= fileSize);
+          break;
+        }
+#endif
+        finish(true);
+      } else {
+        logger.println(F("Failed - Close Connection"));
+        finish(false);
+      }
+      break;
+
+#if defined(GSM_SD_SUPPORT)
+    case 6: // Send the next block of the file
+      if (status == PENDING) {
+        if (*fileOffset >= fileSize) {
+          goToStep(5);
+        } else {
+          blockLength = min(fileSize - *fileOffset, (uint32_t) 512);
+          command("+CIPSEND=" + String(blockLength), ">", 1);
+        }
+      } else if (status == SUCCESS) {
+        sendBlock();
+        nextStep();
+      } else {
+        goToStep(5);
+      }
+      break;
+
+    case 7: // Wait for the block to be sent
+      if (status == PENDING) {
+        expect("OK");
+      } else if (status == SUCCESS && blockLength > 0) {
+        usage.addSent(blockLength);
+        countUsage();
+        *fileOffset += blockLength;
+        goToStep(6);
+      } else {
+        logger.println(F("Failed - Sending File"));
+        goToStep(5);
+      }
+      break;
+#endif
+
+    case 8: // Close the connection left by a failed request before making it again
+      if (status == PENDING) {
+        command(F("+CIPCLOSE"), "OK", 1);
+      } else {
+        goToStep(0);
+      }
+      break;
+  }
+}
+
+#if defined(GSM_SD_SUPPORT)
+/*
+   Writes the next block of the file, which the GSM is waiting for.
+   The file is read straight into the buffer used to write to the GSM.
+ */
+void GSM_A6::sendBlock() {
+  uint16_t remaining = blockLength;
+
+  if (file->seek(*fileOffset)) {
+    while (remaining > 0) {
+      uint8_t space;
+      uint8_t * into = tx.reserve(space);
+      int count = file->read(into, min((uint16_t) space, remaining));
+      if (count <= 0) break;
+
+      tx.commit(count);
+      remaining -= count;
+    }
+  }
+
+  if (remaining > 0) {
+    // The GSM still needs the whole block, but it won't be counted as sent
+    while (remaining-- > 0) tx.write(' ');
+    blockLength = 0;
+  }
+  tx.send();
+}
+#endif
@@ -0,0 +1,111 @@
+#ifndef _GSM_Policy_h
+#define _GSM_Policy_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#if defined(DEBUG_GSM)
+	#include <SdFat.h>
+	#include <SPI.h>
+#endif
+
+/*
+  Logger used by release builds. Every method is empty and inline,
+  so the compiler removes the calls along with the strings passed to them.
+*/
+class GSM_NullLogger {
+public:
+  bool begin() { return false; }
+  void end() { }
+  void dump(Print & output) { }
+  template <typename T> void response(const T & response, unsigned long start) { }
+
+  template <typename T> void print(const T & value) { }
+  template <typename T> void println(const T & value) { }
+  void println() { }
+};
+
+#if defined(DEBUG_GSM)
+/*
+  Logger used by debug builds, records everything to GSM_log.txt
+  on the SD Card. The SD Card chip select is on pin 10.
+
+  The SD Card and log file are shared by every GSM, so several GSMs
+  can log at once. Each line starts with the number of the GSM
+  which wrote it, e.g. "[2] Command: AT+CSQ".
+*/
+class GSM_SdLogger {
+public:
+  GSM_SdLogger() : id(++instances) { }
+
+  bool begin();
+  void end();
+  void dump(Print & output);
+  void response(const char * response, unsigned long start);
+  void response(const String & response, unsigned long start) {
+    this->response(response.c_str(), start);
+  }
+
+  template <typename T> void print(const T & value) {
+    if (startLine()) file.print(value);
+  }
+  template <typename T> void println(const T & value) {
+    if (startLine()) file.println(value);
+    isLineStart = true;
+  }
+  void println() {
+    if (startLine()) file.println();
+    isLineStart = true;
+  }
+
+private:
+  uint8_t id;
+
+  bool startLine();
+
+  static File file;
+  static SdFat SD;
+  static bool isCardReady;
+  static bool isLineStart;
+  static uint8_t instances;
+};
+#endif
+
+/*
+  Compile time policies, these decide what is logged and which
+  extra features are compiled into the driver.
+
+  Logger       Where debugging information is written to
+  DIAGNOSTICS  Sends extra status commands which are only useful for the log
+  AUTO_TUNE    Searches all baud rates if the GSM can't be synced with
+
+  The policy is chosen for the whole build by DEBUG_GSM rather than being
+  a template parameter of GSM_A6, so every GSM in a sketch uses the same one.
+  The driver is spread over several .cpp files which the Arduino IDE builds
+  once, and GSM_Pool, the SMS handlers and the callbacks all take a GSM_A6&,
+  a template would move all of it into headers and give each policy its own
+  copy of the driver in flash. GSMs sharing the debug policy share one log,
+  see GSM_SdLogger.
+*/
+struct GSM_ReleasePolicy {
+  typedef GSM_NullLogger Logger;
+  static const bool DIAGNOSTICS = false;
+  static const bool AUTO_TUNE = false;
+};
+
+#if defined(DEBUG_GSM)
+struct GSM_DebugPolicy {
+  typedef GSM_SdLogger Logger;
+  static const bool DIAGNOSTICS = true;
+  static const bool AUTO_TUNE = true;
+};
+
+typedef GSM_DebugPolicy GSM_Policy;
+#else
+typedef GSM_ReleasePolicy GSM_Policy;
+#endif
+
+#endif
@@ -0,0 +1,150 @@
+#include "GSM_Pool.h"
+
+GSM_Pool::GSM_Pool()
+  : failureBackoff(60000L), signalRefreshInterval(300000L),
+    count(0), lastSignalRefresh(0), hasSignal(false) { }
+
+/*
+  Adds a GSM to the pool, it should already be initialised
+  and connected to the mobile network.
+
+  @return false if the pool is full
+*/
+bool GSM_Pool::add(GSM_A6 & modem) {
+  if (count == GSM_POOL_SIZE) return false;
+
+  Member & member = members[count++];
+  member.modem = &modem;
+  member.signal = 0;
+  member.failures = 0;
+  member.uploads = 0;
+  member.availableAt = 0;
+  hasSignal = false;
+  return true;
+}
+
+/*
+  @return the number of GSMs in the pool
+*/
+uint8_t GSM_Pool::size() {
+  return count;
+}
+
+/*
+  Checks the signal strength of every GSM in the pool.
+*/
+void GSM_Pool::refreshSignal() {
+  for (uint8_t i = 0; i < count; ++i) {
+    uint8_t signal = members[i].modem->getSignalStrengthRAW();
+    members[i].signal = signal > 31 ? 0 : signal; // 99 is not known
+  }
+  lastSignalRefresh = GSM_millis();
+  hasSignal = true;
+}
+
+void GSM_Pool::refreshSignalIfOld() {
+  if (!hasSignal || GSM_millis() - lastSignalRefresh > signalRefreshInterval) {
+    refreshSignal();
+  }
+}
+
+/*
+  Finds the best GSM that isn't in the skip mask. GSMs that failed
+  recently are only used if every other GSM has failed too.
+
+  @return index of the GSM or -1 if there are none left
+*/
+int8_t GSM_Pool::best(uint8_t skipMask) {
+  int8_t bestIndex = -1;
+  bool bestAvailable = false;
+  unsigned long now = GSM_millis();
+
+  for (uint8_t i = 0; i < count; ++i) {
+    if (skipMask & (1 << i)) continue;
+
+    Member & member = members[i];
+    bool available = member.failures == 0 || (long) (now - member.availableAt) >= 0;
+
+    if (bestIndex == -1) {
+      bestIndex = i;
+      bestAvailable = available;
+      continue;
+    }
+
+    Member & current = members[bestIndex];
+    if (available != bestAvailable) {
+      if (available) {
+        bestIndex = i;
+        bestAvailable = true;
+      }
+    } else if (member.signal > current.signal) {
+      bestIndex = i;
+    } else if (member.signal == current.signal && member.uploads < current.uploads) {
+      // Same signal so share the uploads between them
+      bestIndex = i;
+    }
+  }
+
+  return bestIndex;
+}
+
+/*
+  Gets the GSM which should be used for the next upload.
+
+  @return the GSM to use or NULL if the pool is empty
+*/
+GSM_A6 * GSM_Pool::next() {
+  if (count == 0) return NULL;
+
+  refreshSignalIfOld();
+
+  return members[best(0)].modem;
+}
+
+/*
+  Stops a GSM from being used until the failure back off has passed.
+  Each consecutive failure doubles the back off.
+*/
+void GSM_Pool::markFailed(GSM_A6 & modem) {
+  int8_t index = find(modem);
+  if (index < 0) return;
+
+  Member & member = members[index];
+  if (member.failures < 8) ++member.failures;
+  member.availableAt = GSM_millis() + (failureBackoff << (member.failures - 1));
+}
+
+int8_t GSM_Pool::find(GSM_A6 & modem) {
+  for (uint8_t i = 0; i < count; ++i) {
+    if (members[i].modem == &modem) return i;
+  }
+  return -1;
+}
+
+/*
+  Makes a get request using the best GSM, if it fails the
+  remaining GSMs are tried in order until one succeeds.
+
+  @return true if one of the GSMs completed the request
+*/
+bool GSM_Pool::getRequest(const String & server, const String & resource) {
+  if (count == 0) return false;
+
+  refreshSignalIfOld();
+
+  uint8_t tried = 0;
+  for (uint8_t attempt = 0; attempt < count; ++attempt) {
+    int8_t index = best(tried);
+    tried |= 1 << index;
+
+    Member & member = members[index];
+    if (member.modem->getRequest(server, resource)) {
+      member.failures = 0;
+      ++member.uploads;
+      return true;
+    }
+    markFailed(*member.modem);
+  }
+
+  return false;
+}
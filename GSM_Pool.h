@@ -0,0 +1,53 @@
+#ifndef _GSM_Pool_h
+#define _GSM_Pool_h
+
+#include "GSM_A6.h"
+
+#define GSM_POOL_SIZE 4
+
+/*
+  Shares uploads between several GSMs, each on their own serial port.
+  The GSM with the best signal that hasn't recently failed is used first,
+  if it fails the next best GSM is tried.
+
+  Only GET requests can be shared, and getRequest() blocks until a GSM
+  completes it or they have all failed. Use the GSMs directly for anything else.
+*/
+class GSM_Pool {
+public:
+  GSM_Pool();
+
+  bool add(GSM_A6 & modem);
+  uint8_t size();
+
+  GSM_A6 * next();
+  void markFailed(GSM_A6 & modem);
+  void refreshSignal();
+
+  bool getRequest(const String & server, const String & resource);
+
+  // Time in milliseconds to stop using a GSM after it fails
+  unsigned long failureBackoff;
+  // Time in milliseconds before the signal strength is checked again
+  unsigned long signalRefreshInterval;
+
+private:
+  struct Member {
+    GSM_A6 * modem;
+    uint8_t signal;           // Raw signal strength, 0 if not known
+    uint8_t failures;         // Consecutive failures
+    uint16_t uploads;         // Successful uploads
+    unsigned long availableAt; // millis() when the GSM can be used again
+  };
+
+  Member members[GSM_POOL_SIZE];
+  uint8_t count;
+  unsigned long lastSignalRefresh;
+  bool hasSignal;
+
+  void refreshSignalIfOld();
+  int8_t find(GSM_A6 & modem);
+  int8_t best(uint8_t skipMask);
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "GSM_Response.h"
+
+static const char FATAL_ERROR_PATTERN[] PROGMEM = "FATAL ERROR";
+static const char COMMAND_FAILURE_PATTERN[] PROGMEM = "Excute command failure";
+static const char UNKNOWN_ERROR_PATTERN[] PROGMEM = "Unknown error";
+static const char CME_ERROR_PATTERN[] PROGMEM = "+CME ERROR:";
+static const char CMS_ERROR_PATTERN[] PROGMEM = "+CMS ERROR:";
+static const char ERROR_PATTERN[] PROGMEM = "ERROR";
+
+// In the same order as GSM_Response, starting from GSM_RESPONSE_FATAL_ERROR
+static const char * const PATTERNS[] PROGMEM = {
+  FATAL_ERROR_PATTERN,
+  COMMAND_FAILURE_PATTERN,
+  UNKNOWN_ERROR_PATTERN,
+  CME_ERROR_PATTERN,
+  CMS_ERROR_PATTERN,
+  ERROR_PATTERN,
+};
+
+// Characters found in the patterns above, one bit for each ASCII character
+static const uint8_t PATTERN_CHARACTERS[16] PROGMEM = {
+  0x00, 0x00, 0x00, 0x00, 0x01, 0x08, 0x00, 0x04,
+  0x6A, 0xB0, 0x3C, 0x00, 0x7A, 0xFA, 0xB4, 0x01,
+};
+
+/*
+  @return true if the character is in any of the fixed patterns
+*/
+static bool isPatternCharacter(char c) {
+  uint8_t code = c;
+  return code < 128 && (pgm_read_byte(&PATTERN_CHARACTERS[code >> 3]) & (1 << (code & 7)));
+}
+
+/*
+  Starts matching a new response.
+
+  @param expected The response being waited for, this must remain
+                  in memory until matching has finished.
+*/
+void GSM_ResponseMatcher::begin(const char * expected) {
+  this->expected = expected;
+  reset();
+}
+
+/*
+  Starts matching a new line.
+*/
+void GSM_ResponseMatcher::reset() {
+  memset(progress, 0, sizeof(progress));
+  matched = 0;
+}
+
+/*
+  Gets a character of a pattern, pattern 0 is the expected response.
+
+  @return the character or '\0' at the end of the pattern
+*/
+char GSM_ResponseMatcher::patternAt(uint8_t pattern, uint8_t index) {
+  if (pattern == 0) return expected[index];
+
+  const char * text = (const char *) pgm_read_ptr(&PATTERNS[pattern - 1]);
+  return pgm_read_byte(text + index);
+}
+
+/*
+  Finds how much of the pattern still matches after a mismatch.
+
+  @param length The number of characters which matched before c
+  @param c The character which didn't match
+
+  @return the length of the longest prefix of the pattern ending in c
+*/
+uint8_t GSM_ResponseMatcher::fallback(uint8_t pattern, uint8_t length, char c) {
+  for (uint8_t size = length; size > 0; --size) {
+    if (patternAt(pattern, size - 1) != c) continue;
+
+    // The first (size - 1) characters must match the end of what was matched
+    uint8_t offset = length - size + 1;
+    uint8_t i = 0;
+    while (i < size - 1 && patternAt(pattern, i) == patternAt(pattern, offset + i)) {
+      ++i;
+    }
+    if (i == size - 1) return size;
+  }
+  return 0;
+}
+
+/*
+  Adds the next character of the line. Most characters in a reply, such
+  as digits and punctuation, aren't in any of the fixed patterns, so they
+  only need checking against the expected response. Patterns which
+  haven't started matching are only checked against their first character.
+*/
+void GSM_ResponseMatcher::add(char c) {
+  uint8_t patterns = GSM_RESPONSE_PATTERNS;
+  if (!isPatternCharacter(c)) {
+    memset(progress + 1, 0, GSM_RESPONSE_PATTERNS - 1);
+    patterns = 1;
+  }
+
+  for (uint8_t pattern = 0; pattern < patterns; ++pattern) {
+    if (matched & (1 << pattern)) continue;
+
+    uint8_t length = progress[pattern];
+    char next = patternAt(pattern, length);
+    if (next == c) {
+      next = patternAt(pattern, ++length);
+    } else if (length > 0) {
+      length = fallback(pattern, length, c);
+      next = patternAt(pattern, length);
+    }
+
+    if (next == '\0') {
+      matched |= 1 << pattern;
+    }
+    progress[pattern] = length;
+  }
+}
+
+/*
+  @return true if the expected response has been found on this line
+*/
+bool GSM_ResponseMatcher::hasExpected() {
+  return matched & 1;
+}
+
+/*
+  @return the highest priority response found on this line
+*/
+GSM_Response GSM_ResponseMatcher::result() {
+  for (uint8_t pattern = 0; pattern < GSM_RESPONSE_PATTERNS; ++pattern) {
+    if (matched & (1 << pattern)) return (GSM_Response) (pattern + 1);
+  }
+  return GSM_RESPONSE_NONE;
+}
@@ -0,0 +1,49 @@
+#ifndef _GSM_Response_h
+#define _GSM_Response_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// Responses recognised on a line, highest priority first
+enum GSM_Response : uint8_t {
+  GSM_RESPONSE_NONE = 0,
+  GSM_RESPONSE_EXPECTED = 1,        // The response the command was waiting for
+  GSM_RESPONSE_FATAL_ERROR = 2,     // FATAL ERROR
+  GSM_RESPONSE_COMMAND_FAILURE = 3, // Excute command failure
+  GSM_RESPONSE_UNKNOWN_ERROR = 4,   // Unknown error
+  GSM_RESPONSE_CME_ERROR = 5,       // +CME ERROR:
+  GSM_RESPONSE_CMS_ERROR = 6,       // +CMS ERROR:
+  GSM_RESPONSE_ERROR = 7,           // Any other ERROR
+};
+
+#define GSM_RESPONSE_PATTERNS 7
+
+/*
+  Classifies a line sent by the GSM in a single pass, one character
+  at a time as it arrives. Every pattern is tracked at once, on a
+  mismatch each pattern falls back to its longest prefix which still
+  matches (the same as Knuth-Morris-Pratt), so no character is read twice.
+  The fixed patterns are kept in flash, only one byte of RAM is used per pattern.
+*/
+class GSM_ResponseMatcher {
+public:
+  void begin(const char * expected);
+  void reset();
+  void add(char c);
+
+  bool hasExpected();
+  GSM_Response result();
+
+private:
+  const char * expected;
+  uint8_t progress[GSM_RESPONSE_PATTERNS];
+  uint8_t matched;
+
+  char patternAt(uint8_t pattern, uint8_t index);
+  uint8_t fallback(uint8_t pattern, uint8_t length, char c);
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "GSM_A6.h"
+
+// +CME ERROR codes which sending the command again won't fix,
+// such as SIM problems (10-18), bad parameters (50) and PDP authentication (149)
+static const uint16_t FINAL_CME_CODES[] PROGMEM = { 4, 10, 11, 12, 13, 15, 16, 17, 18, 50, 149 };
+
+// +CMS ERROR codes which sending the command again won't fix,
+// such as bad parameters (302-305), SIM problems (310-318) and no SMS centre (330)
+static const uint16_t FINAL_CMS_CODES[] PROGMEM = { 302, 303, 304, 305, 310, 311, 312, 313, 316, 317, 318, 321, 330 };
+
+// The same errors when reported as text, +CMEE=2
+static const char FINAL_TEXT_1[] PROGMEM = "not supported";
+static const char FINAL_TEXT_2[] PROGMEM = "SIM not inserted";
+static const char FINAL_TEXT_3[] PROGMEM = "SIM PIN";
+static const char FINAL_TEXT_4[] PROGMEM = "SIM PUK";
+static const char FINAL_TEXT_5[] PROGMEM = "SIM failure";
+static const char FINAL_TEXT_6[] PROGMEM = "SIM wrong";
+static const char FINAL_TEXT_7[] PROGMEM = "password";
+static const char FINAL_TEXT_8[] PROGMEM = "parameter";
+static const char FINAL_TEXT_9[] PROGMEM = "authentication";
+
+static const char * const FINAL_TEXTS[] PROGMEM = {
+  FINAL_TEXT_1, FINAL_TEXT_2, FINAL_TEXT_3, FINAL_TEXT_4, FINAL_TEXT_5,
+  FINAL_TEXT_6, FINAL_TEXT_7, FINAL_TEXT_8, FINAL_TEXT_9,
+};
+
+#define COUNT(table) (sizeof(table) / sizeof(table[0]))
+
+GSM_RetryPolicy::GSM_RetryPolicy()
+  : requestAttempts(2), baseDelay(250), maxDelay(8000), failureLimit(5), openTime(60000L),
+    failures(0), openedAt(0), randomState(0x9E3779B9UL) { }
+
+/*
+   @param attempt The retry about to be made, 1 for the first retry
+
+   @return the time in milliseconds to wait before retrying, between
+           half and all of the doubled delay so retries are spread out
+ */
+unsigned long GSM_RetryPolicy::backoff(uint8_t attempt) {
+  if (attempt == 0) return 0;
+
+  unsigned long wait = baseDelay;
+  for (uint8_t i = 1; i < attempt && wait < maxDelay; ++i) wait *= 2;
+  if (wait > maxDelay) wait = maxDelay;
+
+  return wait / 2 + nextRandom() % (wait / 2 + 1);
+}
+
+/*
+   Mixes a value which differs between GSMs into the generator used
+   to randomise the waits, such as micros() when a reply arrives.
+ */
+void GSM_RetryPolicy::addEntropy(uint32_t value) {
+  randomState ^= value;
+  nextRandom();
+}
+
+// Xorshift, which never leaves 0 so it is kept away from it
+uint32_t GSM_RetryPolicy::nextRandom() {
+  if (randomState == 0) randomState = 0x9E3779B9UL;
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+static bool isCodeIn(uint16_t code, const uint16_t * codes, uint8_t count) {
+  for (uint8_t i = 0; i < count; ++i) {
+    if (pgm_read_word(&codes[i]) == code) return true;
+  }
+  return false;
+}
+
+/*
+   Classifies the line which ended a failed response.
+
+   @param type How the line was classified, see GSM_ResponseMatcher
+   @param response The line, such as +CME ERROR: 10 or +CME ERROR: SIM not inserted
+
+   @return false if sending the command again won't help
+ */
+bool GSM_RetryPolicy::isRetryable(GSM_Response type, const char * response) {
+  if (type == GSM_RESPONSE_FATAL_ERROR) return false;
+  if (type != GSM_RESPONSE_CME_ERROR && type != GSM_RESPONSE_CMS_ERROR) return true;
+
+  // Both start +CMx ERROR:
+  const char * error = strstr(response, " ERROR:");
+  if (error == NULL) return true;
+  error += 7;
+  while (*error == ' ') ++error;
+
+  if (isDigit(*error)) {
+    uint16_t code = atoi(error);
+    if (type == GSM_RESPONSE_CME_ERROR) return !isCodeIn(code, FINAL_CME_CODES, COUNT(FINAL_CME_CODES));
+    return !isCodeIn(code, FINAL_CMS_CODES, COUNT(FINAL_CMS_CODES));
+  }
+
+  for (uint8_t i = 0; i < COUNT(FINAL_TEXTS); ++i) {
+    if (strstr_P(error, (const char *) pgm_read_ptr(&FINAL_TEXTS[i])) != NULL) return false;
+  }
+  return true;
+}
+
+/*
+   @return true if new requests should fail straight away
+ */
+bool GSM_RetryPolicy::isOpen() {
+  if (failureLimit == 0 || failures < failureLimit) return false;
+  return GSM_millis() - openedAt < openTime;
+}
+
+/*
+   Records a request which succeeded, closing the circuit.
+ */
+void GSM_RetryPolicy::succeeded() {
+  failures = 0;
+}
+
+/*
+   Records a request which failed after every attempt. Once the
+   circuit is open each failure keeps it open for another openTime.
+ */
+void GSM_RetryPolicy::failed() {
+  if (failures < 255) ++failures;
+  if (failureLimit > 0 && failures >= failureLimit) openedAt = GSM_millis();
+}
@@ -0,0 +1,52 @@
+#ifndef _GSM_Retry_h
+#define _GSM_Retry_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#include "GSM_Response.h"
+
+/*
+  Decides when a failed command or request is tried again. Commands
+  are sent again after a growing, randomised wait, so GSMs which failed
+  together don't all retry together on a busy network. Errors which
+  won't go away by trying again, such as a missing SIM, are given up
+  on straight away. After several requests fail in a row the circuit
+  opens and new requests fail at once until openTime has passed, then
+  one request is let through to check the network has come back.
+
+  The waits are randomised by a generator kept for each GSM rather than
+  random(), which is the same on every board unless the sketch seeds it.
+  The time each line arrives from the GSM, to the microsecond, is mixed
+  in with addEntropy(), so GSMs started together still wait differently.
+*/
+class GSM_RetryPolicy {
+public:
+  GSM_RetryPolicy();
+
+  unsigned long backoff(uint8_t attempt);
+  static bool isRetryable(GSM_Response type, const char * response);
+
+  bool isOpen();
+  void succeeded();
+  void failed();
+  void addEntropy(uint32_t value);
+
+  uint8_t requestAttempts;  // Times a request to a server is made before giving up
+  unsigned long baseDelay;  // Time in milliseconds before the first retry, doubled for each retry after
+  unsigned long maxDelay;   // Longest time in milliseconds between retries
+  uint8_t failureLimit;     // Requests failing in a row before the circuit opens, 0 to never open
+  unsigned long openTime;   // Time in milliseconds the circuit stays open
+
+private:
+  uint8_t failures;         // Requests failed in a row
+  unsigned long openedAt;   // millis() the circuit last opened
+  uint32_t randomState;     // Randomises the waits, see addEntropy()
+
+  uint32_t nextRandom();
+};
+
+#endif
@@ -0,0 +1,422 @@
+#include "GSM_A6.h"
+#include "GSM_Simulator.h"
+
+GSM_Simulator::GSM_Simulator()
+  : latency(20), jitter(0), registerTime(3000), selectTime(1000), operatorCode("23410"), signal(21), errorRate(0), silenceRate(0), newFirmware(false),
+    powerPin(-1), resetPin(-1), dtrPin(-1), sleepCurrent(3), idleCurrent(20), busyCurrent(150),
+    lineLength(0), outputStart(0), outputLength(0), readyAt(0), startedAt(0), isOperatorSelected(false), isNumericOperator(false), isIpReady(false),
+    isSending(false), isLineFeedSkipped(false), hasData(false), dataLeft(0), bridge(NULL), id(0), listing(0),
+    isOn(true), isDtrHigh(false), sleepMode(0), isSleeping(false), lastCommand(0), chargedAt(0), charge(0), chargeRemainder(0) {
+  for (uint8_t i = 0; i < GSM_SIMULATOR_SMS_SLOTS; ++i) {
+    messages[i].status = SMS_EMPTY;
+  }
+}
+
+int GSM_Simulator::available() {
+  update();
+  if (!isOn) return 0;
+
+  // Messages are listed one at a time as they are read, so they don't need to fit in the output
+  if (outputLength == 0 && listing > 0) listNext();
+  if ((long) (GSM_millis() - readyAt) < 0) return 0;
+  return outputLength;
+}
+
+int GSM_Simulator::read() {
+  int c = peek();
+  if (c >= 0) {
+    outputStart = (outputStart + 1) % GSM_SIMULATOR_OUTPUT_SIZE;
+    --outputLength;
+  }
+  return c;
+}
+
+int GSM_Simulator::peek() {
+  if (available() == 0) return -1;
+  return (uint8_t) output[outputStart];
+}
+
+void GSM_Simulator::flush() { }
+
+size_t GSM_Simulator::write(uint8_t c) {
+  update();
+  if (!isOn || (sleepMode == 1 && isDtrHigh)) return 1;
+
+  lastCommand = GSM_millis();
+  if (isSleeping) {
+    // The first character wakes the GSM and is lost
+    isSleeping = false;
+    lineLength = 0;
+    return 1;
+  }
+
+  if (isSending) {
+    if (isLineFeedSkipped && c == '\n') {
+      isLineFeedSkipped = false;
+      return 1;
+    }
+    isLineFeedSkipped = false;
+
+    if (dataLeft == 0 && c == 0x1A) {
+      endSending();
+    } else {
+      // Started with the first character, so data from other GSMs isn't mixed in
+      if (bridge && !hasData) {
+        bridge->print('#');
+        bridge->println(id);
+      }
+      hasData = true;
+      if (bridge) bridge->write(c);
+      if (dataLeft > 0 && --dataLeft == 0) endSending();
+    }
+    return 1;
+  }
+
+  if (c == '\r') {
+    line[lineLength] = '\0';
+    if (lineLength > 0) runCommand();
+    lineLength = 0;
+  } else if (c != '\n' && lineLength < GSM_SIMULATOR_LINE_SIZE - 1) {
+    line[lineLength++] = c;
+  }
+  return 1;
+}
+
+/*
+   Writes the data sent over TCP to the output, between a line
+   with # and the id, and a line with #end.
+
+   @param output Where to write the data, such as Serial
+   @param id Identifies this GSM in the output
+ */
+void GSM_Simulator::bridgeTo(Print & output, uint16_t id) {
+  bridge = &output;
+  this->id = id;
+}
+
+/*
+   Stores a new message on the simulated SIM Card and reports it
+   with +CMTI, as if it had just been received.
+
+   @return the index of the message, 0 if the SIM Card is full
+ */
+uint8_t GSM_Simulator::receiveSMS(const char * sender, const char * text) {
+  for (uint8_t i = 0; i < GSM_SIMULATOR_SMS_SLOTS; ++i) {
+    Sms & message = messages[i];
+    if (message.status != SMS_EMPTY) continue;
+
+    message.status = SMS_UNREAD;
+    strncpy(message.sender, sender, sizeof(message.sender) - 1);
+    message.sender[sizeof(message.sender) - 1] = '\0';
+    strncpy(message.text, text, sizeof(message.text) - 1);
+    message.text[sizeof(message.text) - 1] = '\0';
+
+    char report[24];
+    snprintf_P(report, sizeof(report), PSTR("+CMTI: \"SM\",%u"), i + 1);
+    reply(report);
+    return i + 1;
+  }
+  return 0;
+}
+
+/*
+   @return true once registered with the network, sooner if +COPS selected the operator
+ */
+bool GSM_Simulator::isRegistered() {
+  return GSM_millis() - startedAt >= (isOperatorSelected ? selectTime : registerTime);
+}
+
+/*
+   @param command Stored in flash (PSTR)
+
+   @return true if the line starts with the command
+ */
+bool GSM_Simulator::isCommand(const char * command) {
+  return strncmp_P(line, command, strlen_P(command)) == 0;
+}
+
+void GSM_Simulator::runCommand() {
+  // Plain AT always gets a reply, so the driver can check the GSM still works
+  bool isAT = strcmp(line, "AT") == 0;
+  if (!isAT && (long) random(100) < silenceRate) return;
+  if (!isAT && (long) random(100) < errorRate) {
+    reply(F("ERROR"));
+    return;
+  }
+
+  if (isCommand(PSTR("AT&F"))) {
+    startedAt = GSM_millis();
+    isIpReady = false;
+    isOperatorSelected = false;
+    isNumericOperator = false;
+    reply(F("OK"));
+  } else if (isCommand(PSTR("ATI"))) {
+    reply(F("Ai Thinker Co.LTD"));
+    reply(F("A6"));
+    reply(newFirmware ? F("V03.03.20161229019H03") : F("V03.03.20160830018H03"));
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+COPS=4,2,\""))) {
+    // Registers sooner with the operator given, otherwise the search carries on
+    if (!isRegistered() && strncmp(line + 13, operatorCode, strlen(operatorCode)) == 0 && line[13 + strlen(operatorCode)] == '"') {
+      startedAt = GSM_millis();
+      isOperatorSelected = true;
+    }
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+COPS=3,"))) {
+    isNumericOperator = atoi(line + 10) == 2;
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+COPS?"))) {
+    if (!isRegistered()) {
+      reply(F("+COPS: 0"));
+    } else if (isNumericOperator) {
+      char text[24];
+      snprintf(text, sizeof(text), "+COPS: 0,2,\"%s\"", operatorCode);
+      reply(text);
+    } else {
+      reply(F("+COPS: 0,0,\"Simulated\""));
+    }
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+CREG?"))) {
+    if (isRegistered()) {
+      reply(F("+CREG: 2,1,\"1A2B\",\"00C3\""));
+    } else {
+      reply(F("+CREG: 2,2"));
+    }
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+CSQ"))) {
+    char text[16];
+    snprintf_P(text, sizeof(text), PSTR("+CSQ: %u,0"), signal);
+    reply(text);
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+CIPSTATUS"))) {
+    reply(F("OK"));
+    reply(newFirmware && !isIpReady ? F("STATE: IP START") : F("STATE: IP GPRSACT"));
+  } else if (isCommand(PSTR("AT+CIICR"))) {
+    isIpReady = newFirmware;
+    reply(newFirmware ? F("OK") : F("ERROR"));
+  } else if (isCommand(PSTR("AT+CIFSR"))) {
+    if (newFirmware && !isIpReady) {
+      reply(F("ERROR"));
+    } else {
+      reply(F("10.0.0.1"));
+      reply(F("OK"));
+    }
+  } else if (isCommand(PSTR("AT+CDNSGIP="))) {
+    reply(F("+CDNSGIP: 1,\"\",\"10.0.0.2\""));
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+CIPSTART="))) {
+    reply(F("OK"));
+    reply(F("CONNECT OK"));
+  } else if (isCommand(PSTR("AT+CIPSEND"))) {
+    isSending = true;
+    isLineFeedSkipped = true;
+    dataLeft = line[10] == '=' ? atoi(line + 11) : 0;
+    hasData = false;
+    reply(F(">"));
+  } else if (isCommand(PSTR("AT+CMGL="))) {
+    listing = 1;
+  } else if (isCommand(PSTR("AT+CMGR="))) {
+    uint8_t index = atoi(line + 8);
+    if (index >= 1 && index <= GSM_SIMULATOR_SMS_SLOTS && messages[index - 1].status != SMS_EMPTY) {
+      replyMessage("+CMGR: ", index);
+      reply(F("OK"));
+    } else {
+      reply(F("+CMS ERROR: 321")); // Invalid memory index
+    }
+  } else if (isCommand(PSTR("AT+CMGD="))) {
+    const char * flag = strchr(line, ',');
+    deleteMessages(atoi(line + 8), flag != NULL ? atoi(flag + 1) : 0);
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+CPMS?"))) {
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < GSM_SIMULATOR_SMS_SLOTS; ++i) {
+      if (messages[i].status != SMS_EMPTY) ++used;
+    }
+    char text[48];
+    snprintf_P(text, sizeof(text), PSTR("+CPMS: %u,%u,%u,%u,%u,%u"),
+               used, GSM_SIMULATOR_SMS_SLOTS, used, GSM_SIMULATOR_SMS_SLOTS, used, GSM_SIMULATOR_SMS_SLOTS);
+    reply(text);
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+CSCLK="))) {
+    sleepMode = atoi(line + 9);
+    reply(F("OK"));
+  } else if (isCommand(PSTR("AT+CCLK?"))) {
+    reply(F("+CCLK: \"18/07/11,17:26:33+04\""));
+    reply(F("OK"));
+  } else {
+    reply(F("OK"));
+  }
+}
+
+/*
+   Replies with the next message for +CMGL, or OK once every message has been listed.
+   Messages are marked as read once listed.
+ */
+void GSM_Simulator::listNext() {
+  while (listing <= GSM_SIMULATOR_SMS_SLOTS && messages[listing - 1].status == SMS_EMPTY) ++listing;
+
+  if (listing > GSM_SIMULATOR_SMS_SLOTS) {
+    listing = 0;
+    reply(F("OK"));
+    return;
+  }
+
+  char header[12];
+  snprintf_P(header, sizeof(header), PSTR("+CMGL: %u,"), listing);
+  replyMessage(header, listing);
+  ++listing;
+}
+
+/*
+   Replies with <header>"<status>","<sender>",,"<time>" followed by
+   the text of the message, then marks it as read.
+
+   @param header Such as +CMGR: or +CMGL: 1,
+ */
+void GSM_Simulator::replyMessage(const char * header, uint8_t index) {
+  Sms & message = messages[index - 1];
+  char text[GSM_SIMULATOR_LINE_SIZE + 16];
+
+  snprintf_P(text, sizeof(text), PSTR("%s\"%s\",\"%s\",,\"18/07/11,17:26:33+04\""),
+             header, message.status == SMS_UNREAD ? "REC UNREAD" : "REC READ", message.sender);
+  reply(text);
+  reply(message.text);
+  message.status = SMS_READ;
+}
+
+/*
+   Deletes messages as +CMGD does.
+
+   @param flag 0 deletes the message at the index, 1 to 3 every read message
+               (there are no sent messages), 4 every message
+ */
+void GSM_Simulator::deleteMessages(uint8_t index, uint8_t flag) {
+  for (uint8_t i = 0; i < GSM_SIMULATOR_SMS_SLOTS; ++i) {
+    Sms & message = messages[i];
+    if ((flag == 0 && i + 1 == index) || (flag >= 1 && flag <= 3 && message.status == SMS_READ) || flag >= 4) {
+      message.status = SMS_EMPTY;
+    }
+  }
+}
+
+/*
+   @return true if sleeping after +CSCLK, and not woken by the DTR pin or a command
+ */
+bool GSM_Simulator::isAsleep() {
+  update();
+  return isSleepMode();
+}
+
+bool GSM_Simulator::isSleepMode() {
+  return sleepMode == 1 ? isDtrHigh : isSleeping;
+}
+
+/*
+   @return the charge used since the simulator was created in milliamp seconds,
+           divide by 3600 for milliamp hours
+ */
+unsigned long GSM_Simulator::getCharge() {
+  update();
+  return charge;
+}
+
+/*
+   Adds the charge used since the last update, then follows the pins
+   and falls asleep with +CSCLK=2 once there have been no commands for a while.
+   Pins are only read here, GSM_A6 checks the serial port straight after
+   switching a pin so the change is seen at the right time.
+ */
+void GSM_Simulator::update() {
+  unsigned long now = GSM_millis();
+
+  unsigned long asleepAt = lastCommand + GSM_SIMULATOR_IDLE_TIME;
+  if (isOn && sleepMode == 2 && !isSleeping && outputLength == 0 && !isSending &&
+      (long) (now - asleepAt) >= 0) {
+    if ((long) (asleepAt - chargedAt) > 0) {
+      addCharge(getCurrent(), asleepAt - chargedAt);
+      chargedAt = asleepAt;
+    }
+    isSleeping = true;
+  }
+
+  addCharge(isOn ? getCurrent() : 0, now - chargedAt);
+  chargedAt = now;
+
+  bool isPowered = (powerPin < 0 || digitalRead(powerPin) == HIGH) &&
+                   (resetPin < 0 || digitalRead(resetPin) == LOW);
+  if (isPowered && !isOn) {
+    // Starts again with the default settings and registers with the network
+    startedAt = now;
+    lastCommand = now;
+    sleepMode = 0;
+    isIpReady = false;
+    isOperatorSelected = false;
+    isNumericOperator = false;
+    isSleeping = false;
+    isSending = false;
+    lineLength = 0;
+  }
+  if (!isPowered) outputLength = 0;
+  isOn = isPowered;
+  isDtrHigh = dtrPin >= 0 && digitalRead(dtrPin) == HIGH;
+}
+
+/*
+   @return the current in milliamps drawn while switched on
+ */
+uint16_t GSM_Simulator::getCurrent() {
+  if (isSleepMode()) return sleepCurrent;
+  if (chargedAt - startedAt < (isOperatorSelected ? selectTime : registerTime) || isSending) return busyCurrent;
+  if (outputLength > 0 && (long) (chargedAt - readyAt) < 0) return busyCurrent;
+  return idleCurrent;
+}
+
+void GSM_Simulator::addCharge(uint16_t current, unsigned long time) {
+  uint32_t used = (uint32_t) current * time + chargeRemainder;
+  charge += used / 1000;
+  chargeRemainder = used % 1000;
+}
+
+void GSM_Simulator::endSending() {
+  isSending = false;
+  if (bridge && hasData) bridge->println(F("\r\n#end"));
+  reply(F("OK"));
+  // The server's reply, as the A6 reports data received
+  if (hasData) reply(F("+CIPRCV:15,HTTP/1.1 200 OK"));
+}
+
+void GSM_Simulator::reply(const __FlashStringHelper * text) {
+  const char * c = (const char *) text;
+  add('\r');
+  add('\n');
+  for (char next = pgm_read_byte(c); next != '\0'; next = pgm_read_byte(++c)) {
+    add(next);
+  }
+  // The prompt isn't followed by a new line
+  if (!isSending) {
+    add('\r');
+    add('\n');
+  }
+}
+
+void GSM_Simulator::reply(const char * text) {
+  add('\r');
+  add('\n');
+  while (*text != '\0') add(*text++);
+  add('\r');
+  add('\n');
+}
+
+/*
+   Adds to the reply, which can be read after the latency.
+   Characters which don't fit are lost, as they would be on a real GSM.
+ */
+void GSM_Simulator::add(char c) {
+  if (outputLength == 0) {
+    readyAt = GSM_millis() + latency + (jitter > 0 ? random(jitter + 1) : 0);
+  }
+  if (outputLength == GSM_SIMULATOR_OUTPUT_SIZE) return;
+
+  output[(outputStart + outputLength) % GSM_SIMULATOR_OUTPUT_SIZE] = c;
+  ++outputLength;
+}
@@ -0,0 +1,120 @@
+#ifndef _GSM_Simulator_h
+#define _GSM_Simulator_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// Longest command kept, longer commands are cut short
+#define GSM_SIMULATOR_LINE_SIZE 64
+// Replies waiting to be read
+#define GSM_SIMULATOR_OUTPUT_SIZE 96
+// Messages which can be stored on the simulated SIM Card
+#define GSM_SIMULATOR_SMS_SLOTS 4
+// Longest message kept, longer messages are cut short
+#define GSM_SIMULATOR_SMS_SIZE 32
+// Time in milliseconds without any commands before sleeping with +CSCLK=2
+#define GSM_SIMULATOR_IDLE_TIME 5000
+
+/*
+  Simulates a GSM A6, so the driver can be run without one. Used in place
+  of the serial port, GSM_A6 gsm = GSM_A6(simulator), it replies to the
+  commands the driver sends after the given latency. The profile can be
+  changed at any time to simulate a poor signal or an unreliable GSM.
+
+  Data sent over TCP can be written to another output, such as Serial,
+  to forward it to a real server. Messages can be received at any time
+  with receiveSMS(), which are then listed, read and deleted the same
+  as on a SIM Card.
+*/
+class GSM_Simulator : public Stream {
+public:
+  GSM_Simulator();
+
+  int available();
+  int read();
+  int peek();
+  void flush();
+  size_t write(uint8_t c);
+  using Print::write;
+
+  void bridgeTo(Print & output, uint16_t id);
+  uint8_t receiveSMS(const char * sender, const char * text);
+  bool isAsleep();
+  unsigned long getCharge();
+
+  unsigned long latency;      // Time in milliseconds before each reply
+  unsigned long jitter;       // Most time in milliseconds randomly added to the latency
+  unsigned long registerTime; // Time in milliseconds from init to registering with the network
+  unsigned long selectTime;   // Time in milliseconds to register once +COPS selects the operator
+  const char * operatorCode;  // Numeric code of the operator reported by +COPS
+  uint8_t signal;             // Raw signal strength reported by +CSQ, 99 if not known
+  uint8_t errorRate;          // Percentage of commands answered with ERROR
+  uint8_t silenceRate;        // Percentage of commands not answered at all
+  bool newFirmware;           // Reports IP START until +CIICR, as newer firmware does
+
+  int8_t powerPin;            // Pins as given to GSM_A6, -1 if not connected
+  int8_t resetPin;
+  int8_t dtrPin;              // Sleeps while HIGH after +CSCLK=1
+
+  uint16_t sleepCurrent;      // Current in milliamps while asleep
+  uint16_t idleCurrent;       // Current in milliamps while registered and waiting
+  uint16_t busyCurrent;       // Current in milliamps while registering or answering a command
+
+private:
+  char line[GSM_SIMULATOR_LINE_SIZE];
+  uint8_t lineLength;
+  char output[GSM_SIMULATOR_OUTPUT_SIZE];
+  uint8_t outputStart;
+  uint8_t outputLength;
+  unsigned long readyAt;   // millis() when the reply can be read
+  unsigned long startedAt; // millis() of the last init
+  bool isOperatorSelected; // Registering with the operator selected by +COPS, which takes selectTime
+  bool isNumericOperator;  // +COPS? reports the operator's numeric code, set by +COPS=3
+
+  bool isIpReady;          // The internet connection has been readied by +CIICR
+  bool isSending;          // Data is being sent over TCP
+  bool isLineFeedSkipped;  // The line feed after +CIPSEND isn't part of the data
+  bool hasData;            // Some of the data has been sent
+  uint16_t dataLeft;       // Length of data left to send, 0 if it ends with 0x1A
+
+  Print * bridge;
+  uint16_t id;
+
+  enum Sms_Status : uint8_t { SMS_EMPTY, SMS_UNREAD, SMS_READ };
+  struct Sms {
+    Sms_Status status;
+    char sender[16];
+    char text[GSM_SIMULATOR_SMS_SIZE];
+  };
+  Sms messages[GSM_SIMULATOR_SMS_SLOTS];
+  uint8_t listing; // Index of the next message to list for +CMGL, 0 when not listing
+
+  bool isOn;
+  bool isDtrHigh;
+  uint8_t sleepMode;          // Set by +CSCLK
+  bool isSleeping;            // Asleep with +CSCLK=2
+  unsigned long lastCommand;  // millis() of the last character written
+  unsigned long chargedAt;    // millis() the charge was last worked out
+  unsigned long charge;       // Milliamp seconds
+  uint16_t chargeRemainder;   // Milliamp milliseconds not yet in charge
+
+  void runCommand();
+  bool isCommand(const char * command);
+  bool isRegistered();
+  void reply(const __FlashStringHelper * text);
+  void reply(const char * text);
+  void add(char c);
+  void endSending();
+  void listNext();
+  void replyMessage(const char * header, uint8_t index);
+  void deleteMessages(uint8_t index, uint8_t flag);
+  void update();
+  bool isSleepMode();
+  uint16_t getCurrent();
+  void addCharge(uint16_t current, unsigned long time);
+};
+
+#endif
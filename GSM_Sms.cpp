@@ -0,0 +1,245 @@
+#include "GSM_A6.h"
+
+#if defined(GSM_EEPROM_ADDRESS)
+  #include <EEPROM.h>
+#endif
+
+/*
+  Commands sent to the GSM by SMS. Each message is matched against the
+  command table while it is in the response buffer, so the content of
+  the message is never copied into a String.
+
+  Messages are only deleted once processed, all in one go, see deleteProcessedSMS().
+*/
+
+// Longest phone number kept for checking the sender, such as +447700900123
+#define GSM_SENDER_SIZE 20
+
+// Highest message index which can be tracked by processedMessages
+#define GSM_MAX_MESSAGES 32
+
+// Marks the processed messages as having been saved to EEPROM
+#define GSM_SMS_SAVED 0x5A
+
+/*
+   Checks if the text starts with the keyword, ignoring case.
+
+   @param keyword Stored in flash (PROGMEM)
+
+   @return the text after the keyword and any spaces, NULL if it doesn't match
+*/
+static const char * matchKeyword(const char * text, const char * keyword) {
+  char k;
+  while ((k = pgm_read_byte(keyword++)) != '\0') {
+    if (tolower(*text++) != tolower(k)) return NULL;
+  }
+
+  if (*text != '\0' && *text != ' ') return NULL;
+  while (*text == ' ') ++text;
+  return text;
+}
+
+/*
+   @param allowedSenders Stored in flash (PROGMEM), ends with NULL
+
+   @return true if the sender is in the list or there is no list
+*/
+static bool isAllowed(const char * sender, const char * const * allowedSenders) {
+  if (allowedSenders == NULL) return true;
+
+  const char * allowed;
+  while ((allowed = (const char *) pgm_read_ptr(allowedSenders++)) != NULL) {
+    if (strcmp_P(sender, allowed) == 0) return true;
+  }
+  return false;
+}
+
+/*
+   Copies the sender from +CMGR: "<status>","<sender>",,"<time>"
+ */
+static void readSender(const char * header, char sender[GSM_SENDER_SIZE]) {
+  const char * c = header;
+  for (uint8_t quotes = 0; quotes < 3 && c != NULL; ++quotes) {
+    c = strchr(c, '"');
+    if (c != NULL) ++c;
+  }
+
+  uint8_t length = 0;
+  while (c != NULL && *c != '"' && *c != '\0' && length < GSM_SENDER_SIZE - 1) {
+    sender[length++] = *c++;
+  }
+  sender[length] = '\0';
+}
+
+/*
+   Finds which message indexes are in use on the SIM Card.
+
+   @param stored Set to a bit for each index in use, bit 0 is index 1
+   @param unread Set to a bit for each message which hasn't been read
+
+   @return false if the messages couldn't be listed
+*/
+bool GSM_A6::listMessages(uint32_t & stored, uint32_t & unread) {
+  stored = 0;
+  unread = 0;
+  discardInput();
+  sendCommand(F("+CMGL=\"ALL\""));
+
+  // +CMGL: <index>,"<status>","<sender>",,"<time>" followed by the content
+  while (readLine(20000L)) {
+    if (strncmp(response, "+CMGL:", 6) == 0) {
+      uint8_t index = atoi(response + 6);
+      if (index >= 1 && index <= GSM_MAX_MESSAGES) {
+        stored |= 1UL << (index - 1);
+        if (strstr(response, "UNREAD") != NULL) unread |= 1UL << (index - 1);
+      }
+    } else if (strcmp(response, "OK") == 0) {
+      return true;
+    } else if (strcmp(response, "ERROR") == 0 || strncmp(response, "+CMS ERROR", 10) == 0) {
+      return false;
+    }
+  }
+  return false;
+}
+
+/*
+   Marks a message as processed, so it is deleted by deleteProcessedSMS().
+   Remembered in EEPROM if GSM_EEPROM_ADDRESS is defined, so messages
+   aren't processed again after a reset.
+
+   @param messageID Index of the message on the SIM Card, as given by getSMS()
+*/
+void GSM_A6::markSMSProcessed(uint8_t messageID) {
+  if (messageID < 1 || messageID > GSM_MAX_MESSAGES) return;
+  processedMessages |= 1UL << (messageID - 1);
+  saveProcessedSMS();
+}
+
+/*
+   Deletes the processed messages in one go, without losing messages which
+   arrive while deleting. Nothing is deleted until every message on the SIM
+   Card has been processed, then every read message is deleted (+CMGD=1,1).
+   Processed messages have all been read, while a message arriving in the
+   meantime is unread so it is kept. The messages are then listed again
+   to find which were deleted, as a new message may already be using an
+   index which was freed.
+
+   Deleting one message at a time isn't used, as the GSM A6 can lose messages.
+
+   @return the number of messages deleted
+*/
+uint8_t GSM_A6::deleteProcessedSMS() {
+  uint32_t stored, unread;
+  if (!listMessages(stored, unread)) return 0;
+
+  // Indexes which are no longer used may be reused by a new message
+  if ((processedMessages & ~stored) != 0) {
+    processedMessages &= stored;
+    saveProcessedSMS();
+  }
+  if (stored == 0 || (stored & ~processedMessages) != 0) return 0;
+
+  if (!sendAndWait(F("+CMGD=1,1"))) return 0;
+
+  uint32_t remaining, remainingUnread;
+  if (!listMessages(remaining, remainingUnread)) {
+    // Every processed message was read, so they have all gone
+    remaining = 0;
+    remainingUnread = 0;
+  }
+
+  // Only read messages which are still there are left marked as processed
+  uint32_t kept = remaining & ~remainingUnread;
+  uint32_t deleted = stored & ~kept;
+  processedMessages &= kept;
+  seenMessages &= kept;
+  currentMessage = 0;
+  saveProcessedSMS();
+
+  uint8_t total = 0;
+  for (; deleted != 0; deleted &= deleted - 1) ++total;
+  logger.print(F("Deleted messages: "));
+  logger.println(total);
+  return total;
+}
+
+void GSM_A6::loadProcessedSMS() {
+#if defined(GSM_EEPROM_ADDRESS)
+  if (EEPROM.read(GSM_EEPROM_SMS) != GSM_SMS_SAVED) return;
+  EEPROM.get(GSM_EEPROM_SMS + 1, processedMessages);
+#endif
+}
+
+void GSM_A6::saveProcessedSMS() {
+#if defined(GSM_EEPROM_ADDRESS)
+  EEPROM.update(GSM_EEPROM_SMS, GSM_SMS_SAVED);
+  EEPROM.put(GSM_EEPROM_SMS + 1, processedMessages);
+#endif
+}
+
+/*
+   Runs the handler for each command sent to the GSM by SMS. A message is
+   a command when it starts with the keyword followed by a space or nothing,
+   the rest of the message is passed to the handler. Handlers may use the
+   GSM, such as to reply to the sender.
+
+   Each command is only handled once, messages which aren't commands are
+   left on the SIM Card for markSMSProcessed() and aren't read again.
+   Commands from senders which aren't allowed are ignored, as are commands
+   longer than GSM_RESPONSE_SIZE, rather than passing the handler the
+   part that fits.
+
+   @param commands Table of commands stored in flash (PROGMEM)
+   @param count The number of commands in the table
+   @param deleteHandled Deletes the messages in one go once all the messages
+                        on the SIM Card have been processed, see deleteProcessedSMS().
+
+   @return the number of commands handled
+*/
+uint8_t GSM_A6::handleSMSCommands(const GSM_SmsCommand * commands, uint8_t count, bool deleteHandled) {
+  uint32_t stored, unread;
+  if (!listMessages(stored, unread)) return 0;
+
+  // A seen message has been read, so an unread one at its index is new
+  seenMessages &= stored & ~unread;
+
+  char sender[GSM_SENDER_SIZE];
+  uint8_t total = 0;
+
+  for (uint8_t index = 1; index <= GSM_MAX_MESSAGES; ++index) {
+    uint32_t bit = 1UL << (index - 1);
+    if (!(stored & bit) || ((processedMessages | seenMessages) & bit)) continue;
+
+    // +CMGR: "<status>","<sender>",,"<time>" followed by the content
+    if (!sendAndWait("+CMGR=" + String(index), "+CMGR:", 1, 5000L)) continue;
+    readSender(response, sender);
+    if (!readLine(5000L)) continue;
+
+    seenMessages |= bit;
+    for (uint8_t i = 0; i < count; ++i) {
+      const char * arguments = matchKeyword(response, (const char *) pgm_read_ptr(&commands[i].keyword));
+      if (arguments == NULL) continue;
+
+      // Also set when the command isn't run, so the message can be deleted
+      markSMSProcessed(index);
+
+      if (isResponseCutShort) {
+        logger.print(F("Command too long from "));
+        logger.println(sender);
+      } else if (isAllowed(sender, (const char * const *) pgm_read_ptr(&commands[i].allowedSenders))) {
+        GSM_SmsHandler handler = (GSM_SmsHandler) pgm_read_ptr(&commands[i].handler);
+        ++total;
+        handler(*this, sender, arguments);
+      } else {
+        logger.print(F("Command not allowed from "));
+        logger.println(sender);
+      }
+      break;
+    }
+  }
+
+  if (deleteHandled && stored != 0 && (stored & ~processedMessages) == 0) {
+    deleteProcessedSMS();
+  }
+  return total;
+}
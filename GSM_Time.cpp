@@ -0,0 +1,61 @@
+#include "GSM_Time.h"
+
+static const uint16_t DAYS_BEFORE_MONTH[] PROGMEM = {
+  0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+/*
+   Reads a number and moves past the character after it.
+ */
+static int readNumber(const char * & text) {
+  int number = atoi(text);
+  while (isDigit(*text)) ++text;
+  if (*text != '\0') ++text;
+  return number;
+}
+
+uint32_t GSM_parseTime(const char * text) {
+  if (text == NULL) return 0;
+  if (*text == '"') ++text;
+
+  // yy/MM/dd,hh:mm:ss+zz
+  int year = readNumber(text);
+  int month = readNumber(text);
+  int day = readNumber(text);
+  int hour = readNumber(text);
+  int minute = readNumber(text);
+  const char * zone = text;
+  int second = readNumber(text);
+  while (isDigit(*zone)) ++zone;
+  int quarterHours = (*zone == '+' || *zone == '-') ? atoi(zone) : 0;
+
+  if (year < 100) year += 2000;
+  if (year < 1970 || year > 2099 || month < 1 || month > 12 || day < 1 || day > 31
+      || hour > 23 || minute > 59 || second > 59) {
+    return 0;
+  }
+
+  // Every 4th year is a leap year between 1970 and 2099
+  uint32_t days = (year - 1970) * 365UL + (year - 1969) / 4;
+  days += pgm_read_word(&DAYS_BEFORE_MONTH[month - 1]) + day - 1;
+  if (month > 2 && year % 4 == 0) ++days;
+
+  return ((days * 24 + hour) * 60 + minute) * 60 + second - quarterHours * 900L;
+}
+
+uint16_t GSM_monthOf(uint32_t time) {
+  if (time == 0) return 0;
+
+  uint32_t days = time / 86400;
+  uint16_t year = 1970;
+  for (uint32_t length = 365U; days >= length; length = year % 4 == 0 ? 366U : 365U) {
+    days -= length;
+    ++year;
+  }
+
+  uint8_t month = 11;
+  while (days < pgm_read_word(&DAYS_BEFORE_MONTH[month]) + (month >= 2 && year % 4 == 0 ? 1U : 0U)) {
+    --month;
+  }
+  return (year - 1970) * 12 + month + 1;
+}
@@ -0,0 +1,25 @@
+#ifndef _GSM_Time_h
+#define _GSM_Time_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+/*
+  Reads a time given by the GSM, such as "18/07/11,17:26:33+04" from +CCLK
+  or a received SMS. The time zone is in quarters of an hour.
+
+  @return seconds since 1 Jan 1970 UTC, 0 if the time isn't valid
+*/
+uint32_t GSM_parseTime(const char * text);
+
+/*
+  @param time Seconds since 1 Jan 1970 UTC, 0 if not known
+
+  @return the month of the time counting from 1 for Jan 1970, 0 if the time isn't known
+*/
+uint16_t GSM_monthOf(uint32_t time);
+
+#endif
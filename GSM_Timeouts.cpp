@@ -0,0 +1,146 @@
+#include "GSM_A6.h"
+
+#if defined(GSM_EEPROM_ADDRESS)
+  #include <EEPROM.h>
+#endif
+
+// Marks the timeouts as having been saved to EEPROM
+#define GSM_TIMEOUTS_SAVED 0x7E
+
+// Bytes each entry takes in EEPROM, the fields are saved one at a time
+// so the layout is the same whatever padding the compiler adds to Entry
+#define GSM_TIMEOUT_SAVED_SIZE 7
+
+#if defined(GSM_EEPROM_ADDRESS)
+static_assert(1 + GSM_TIMEOUT_SLOTS * GSM_TIMEOUT_SAVED_SIZE <= GSM_EEPROM_SMS - GSM_EEPROM_TIMEOUTS,
+  "The timeouts don't fit in the EEPROM before GSM_EEPROM_SMS");
+#endif
+
+// Responses learnt before the timeouts are worth saving again
+#define GSM_TIMEOUTS_SAVE_RATE 64
+
+GSM_Timeouts::GSM_Timeouts() : unsaved(0) {
+  clear();
+}
+
+/*
+  FNV-1a hash of the command up to any '=', so +CIPSEND=12 and
+  +CIPSEND are learnt together. +CREG? and +CREG=2 are learnt apart.
+*/
+uint16_t GSM_Timeouts::hash(const String & command) {
+  uint32_t result = 2166136261UL;
+  for (unsigned int i = 0; i < command.length() && command.charAt(i) != '='; ++i) {
+    result ^= (uint8_t) command.charAt(i);
+    result *= 16777619UL;
+  }
+  uint16_t folded = (result >> 16) ^ (result & 0xFFFF);
+  return folded == 0 ? 1 : folded;
+}
+
+int8_t GSM_Timeouts::indexOf(uint16_t command) {
+  for (uint8_t i = 0; i < GSM_TIMEOUT_SLOTS; ++i) {
+    if (entries[i].command == command) return i;
+  }
+  return -1;
+}
+
+/*
+  @param command Hash of the command, see hash()
+  @param timeout The longest the command may take, used until enough
+                 responses have been learnt
+
+  @return the time in milliseconds to wait for the response
+*/
+unsigned long GSM_Timeouts::get(uint16_t command, unsigned long timeout) {
+  int8_t index = indexOf(command);
+  if (index < 0 || entries[index].samples < GSM_TIMEOUT_SAMPLES) return timeout;
+
+  const Entry & entry = entries[index];
+  unsigned long learnt = (unsigned long) entry.average + 4UL * entry.deviation;
+  if (learnt < GSM_MIN_TIMEOUT) learnt = GSM_MIN_TIMEOUT;
+  return min(learnt, timeout);
+}
+
+/*
+  Learns from the time a response took. A command with no response
+  should be learnt with the full timeout, so the timeout grows again.
+  Once the slots are full the command learnt from the least is replaced.
+
+  @param time Milliseconds from sending the command to the response
+
+  @return true when enough has been learnt to be worth saving
+*/
+bool GSM_Timeouts::learn(uint16_t command, unsigned long time) {
+  uint16_t sample = min(time, 65535UL);
+
+  int8_t index = indexOf(command);
+  if (index < 0) {
+    index = 0;
+    for (uint8_t i = 1; i < GSM_TIMEOUT_SLOTS; ++i) {
+      if (entries[i].samples < entries[index].samples) index = i;
+    }
+    entries[index].command = command;
+    entries[index].samples = 0;
+  }
+
+  Entry & entry = entries[index];
+  if (entry.samples == 0) {
+    entry.average = sample;
+    entry.deviation = sample / 2;
+  } else {
+    int32_t error = (int32_t) sample - entry.average;
+    entry.average += error / 8;
+    entry.deviation += ((error < 0 ? -error : error) - (int32_t) entry.deviation) / 4;
+  }
+  if (entry.samples < 255) ++entry.samples;
+
+  if (++unsaved < GSM_TIMEOUTS_SAVE_RATE) return false;
+  unsaved = 0;
+  return true;
+}
+
+/*
+  Forgets every command, the timeouts given are used again.
+*/
+void GSM_Timeouts::clear() {
+  for (uint8_t i = 0; i < GSM_TIMEOUT_SLOTS; ++i) {
+    entries[i].command = 0;
+    entries[i].samples = 0;
+  }
+}
+
+/*
+  Loads timeouts saved by save().
+*/
+void GSM_Timeouts::load(int address) {
+#if defined(GSM_EEPROM_ADDRESS)
+  if (EEPROM.read(address++) != GSM_TIMEOUTS_SAVED) return;
+
+  for (uint8_t i = 0; i < GSM_TIMEOUT_SLOTS; ++i) {
+    Entry & entry = entries[i];
+    EEPROM.get(address, entry.command);
+    EEPROM.get(address + 2, entry.average);
+    EEPROM.get(address + 4, entry.deviation);
+    entry.samples = EEPROM.read(address + 6);
+    address += GSM_TIMEOUT_SAVED_SIZE;
+  }
+#endif
+}
+
+/*
+  Saves the timeouts to EEPROM, only changed bytes are written.
+*/
+void GSM_Timeouts::save(int address) {
+#if defined(GSM_EEPROM_ADDRESS)
+  EEPROM.update(address++, GSM_TIMEOUTS_SAVED);
+
+  for (uint8_t i = 0; i < GSM_TIMEOUT_SLOTS; ++i) {
+    const Entry & entry = entries[i];
+    EEPROM.put(address, entry.command);
+    EEPROM.put(address + 2, entry.average);
+    EEPROM.put(address + 4, entry.deviation);
+    EEPROM.update(address + 6, entry.samples);
+    address += GSM_TIMEOUT_SAVED_SIZE;
+  }
+#endif
+}
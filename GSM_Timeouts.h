@@ -0,0 +1,52 @@
+#ifndef _GSM_Timeouts_h
+#define _GSM_Timeouts_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// Commands whose response times are learnt
+#define GSM_TIMEOUT_SLOTS 10
+// Responses needed before the learnt timeout is used
+#define GSM_TIMEOUT_SAMPLES 4
+// Shortest timeout in milliseconds, however quick the command
+#define GSM_MIN_TIMEOUT 500
+
+/*
+  Learns how long each command takes to be answered, so a command
+  which usually answers in 100ms times out in 500ms rather than
+  15 seconds. Uses the same estimate as TCP retransmission timeouts,
+  the smoothed response time plus four times its mean deviation,
+  which covers almost every response without keeping them all.
+  Commands are told apart by a hash of the command up to any '='.
+*/
+class GSM_Timeouts {
+public:
+  GSM_Timeouts();
+
+  static uint16_t hash(const String & command);
+
+  unsigned long get(uint16_t command, unsigned long timeout);
+  bool learn(uint16_t command, unsigned long time);
+  void clear();
+
+  void load(int address);
+  void save(int address);
+
+private:
+  struct Entry {
+    uint16_t command;   // Hash of the command, 0 if empty
+    uint16_t average;   // Smoothed response time in milliseconds
+    uint16_t deviation; // Smoothed mean deviation in milliseconds
+    uint8_t samples;    // Responses learnt from, stops at 255
+  };
+
+  Entry entries[GSM_TIMEOUT_SLOTS];
+  uint8_t unsaved; // Responses learnt since the last save
+
+  int8_t indexOf(uint16_t command);
+};
+
+#endif
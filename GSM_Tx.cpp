@@ -0,0 +1,88 @@
+#include "GSM_A6.h"
+
+GSM_TxBuffer::GSM_TxBuffer(Stream & serial)
+  : writeTime(0), written(0), serial(serial), length(0), ctsPin(-1) { }
+
+size_t GSM_TxBuffer::write(uint8_t c) {
+  if (length == GSM_TX_SIZE) send();
+  buffer[length++] = c;
+  return 1;
+}
+
+size_t GSM_TxBuffer::write(const uint8_t * data, size_t size) {
+  for (size_t i = 0; i < size; ) {
+    if (length == GSM_TX_SIZE) send();
+
+    size_t count = min((size_t) (GSM_TX_SIZE - length), size - i);
+    memcpy(buffer + length, data + i, count);
+    length += count;
+    i += count;
+  }
+  return size;
+}
+
+/*
+   Gives space in the buffer to be filled directly, such as by reading
+   a file into it. Must be followed by commit().
+
+   @param size Set to the amount of space, at least 1
+
+   @return where to put the characters
+ */
+uint8_t * GSM_TxBuffer::reserve(uint8_t & size) {
+  if (length == GSM_TX_SIZE) send();
+  size = GSM_TX_SIZE - length;
+  return buffer + length;
+}
+
+/*
+   Adds the characters put into the space given by reserve().
+ */
+void GSM_TxBuffer::commit(uint8_t size) {
+  length += size;
+}
+
+/*
+   Writes everything collected so far to the serial port.
+ */
+void GSM_TxBuffer::send() {
+  if (length == 0) return;
+
+  unsigned long start = GSM_micros();
+  if (ctsPin < 0) {
+    serial.write(buffer, length);
+  } else {
+    for (uint8_t i = 0; i < length; ++i) {
+      waitUntilClear();
+      serial.write(buffer[i]);
+    }
+  }
+  writeTime += GSM_micros() - start;
+  written += length;
+  length = 0;
+}
+
+/*
+   @return the total characters written, including those not yet sent
+ */
+uint32_t GSM_TxBuffer::count() {
+  return written + length;
+}
+
+/*
+   Only writes to the GSM while its CTS pin is low.
+
+   @param ctsPin The pin connected to the GSM's CTS pin, -1 to stop using it
+ */
+void GSM_TxBuffer::useFlowControl(int8_t ctsPin) {
+  this->ctsPin = ctsPin;
+}
+
+/*
+   Waits for the GSM to be ready for more, giving up after a second
+   in case the GSM has stopped responding.
+ */
+void GSM_TxBuffer::waitUntilClear() {
+  unsigned long start = GSM_millis();
+  while (digitalRead(ctsPin) == HIGH && GSM_millis() - start < 1000) { }
+}
@@ -0,0 +1,47 @@
+#ifndef _GSM_Tx_h
+#define _GSM_Tx_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// Characters collected before they have to be written to the serial port
+#define GSM_TX_SIZE 64
+
+/*
+  Collects what is written to the GSM, so each command is written to the
+  serial port in one go instead of a few characters at a time. Nothing is
+  written until send() is called or the buffer is full, and send() doesn't
+  wait for the characters to leave the serial port.
+*/
+class GSM_TxBuffer : public Print {
+public:
+  GSM_TxBuffer(Stream & serial);
+
+  size_t write(uint8_t c);
+  size_t write(const uint8_t * data, size_t size);
+  using Print::write;
+
+  uint8_t * reserve(uint8_t & size);
+  void commit(uint8_t size);
+  void send();
+  void useFlowControl(int8_t ctsPin);
+  uint32_t count();
+
+  // Total time in microseconds spent writing to the serial port
+  uint32_t writeTime;
+  // Total characters written to the serial port
+  uint32_t written;
+
+private:
+  Stream & serial;
+  uint8_t buffer[GSM_TX_SIZE];
+  uint8_t length;
+  int8_t ctsPin; // -1 when flow control isn't used
+
+  void waitUntilClear();
+};
+
+#endif
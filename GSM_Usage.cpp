@@ -0,0 +1,119 @@
+#include "GSM_A6.h"
+
+#if defined(GSM_EEPROM_ADDRESS)
+  #include <EEPROM.h>
+#endif
+
+// Marks the monthly totals as having been saved to EEPROM
+#define GSM_USAGE_SAVED 0x69
+
+GSM_Usage::GSM_Usage()
+  : session(), month(), budget(0), smsBudget(0), monthNumber(0), savedTotal(0), savedSMS(0), isLoaded(false) { }
+
+void GSM_Usage::add(uint32_t sent, uint32_t received, uint32_t overhead, uint16_t segments, uint16_t connections, uint16_t smsParts) {
+  GSM_DataUsage * totals[] = { &session, &month };
+  for (uint8_t i = 0; i < 2; ++i) {
+    GSM_DataUsage & usage = *totals[i];
+    usage.bytesSent += sent;
+    usage.bytesReceived += received;
+    usage.overhead += overhead;
+    usage.segments += segments;
+    usage.connections += connections;
+    usage.smsParts += smsParts;
+  }
+}
+
+/*
+  Counts data sent over TCP, with a header on each segment and on its acknowledgement.
+*/
+void GSM_Usage::addSent(uint32_t bytes) {
+  if (bytes == 0) return;
+  uint16_t segments = (bytes + GSM_TCP_SEGMENT - 1) / GSM_TCP_SEGMENT;
+  add(bytes, 0, segments * 2UL * GSM_TCP_HEADER, segments, 0, 0);
+}
+
+/*
+  Counts data received over TCP, reported as it arrives so each report is one segment.
+*/
+void GSM_Usage::addReceived(uint32_t bytes) {
+  add(0, bytes, 2 * GSM_TCP_HEADER, 0, 0, 0);
+}
+
+void GSM_Usage::addConnection() {
+  add(0, 0, GSM_TCP_CONNECTION_PACKETS * GSM_TCP_HEADER, 0, 1, 0);
+}
+
+/*
+  Counts a SMS, messages longer than 160 characters are sent in parts of 153.
+*/
+void GSM_Usage::addSMS(uint32_t characters) {
+  add(0, 0, 0, 0, 0, characters <= 160 ? 1 : (characters + 152) / 153);
+}
+
+/*
+  Starts counting a new month when the time is in a different month.
+  Call after each change.
+
+  @param time Seconds since 1970, 0 if not known
+
+  @return true if the monthly totals are worth saving
+*/
+bool GSM_Usage::update(uint32_t time) {
+  uint16_t now = GSM_monthOf(time);
+  bool isNewMonth = now != 0 && now != monthNumber;
+  if (isNewMonth) {
+    // Counted before the month was known, so it is kept in this month
+    if (monthNumber != 0) month = GSM_DataUsage();
+    monthNumber = now;
+  }
+
+  if (!isNewMonth && month.smsParts == savedSMS && getMonthlyTotal() - savedTotal < GSM_USAGE_SAVE_RATE) return false;
+  savedTotal = getMonthlyTotal();
+  savedSMS = month.smsParts;
+  return true;
+}
+
+/*
+  @param isSMS true to check the SMS budget, otherwise the data budget
+
+  @return true if this month's budget has been used up
+*/
+bool GSM_Usage::isOverBudget(bool isSMS) {
+  if (isSMS) return smsBudget > 0 && month.smsParts >= smsBudget;
+  return budget > 0 && getMonthlyTotal() >= budget;
+}
+
+/*
+  @return the bytes used this month, including headers
+*/
+uint32_t GSM_Usage::getMonthlyTotal() {
+  return month.bytesSent + month.bytesReceived + month.overhead;
+}
+
+/*
+  Loads the monthly totals saved by save(). Only loaded the first time,
+  after that they are counted in memory.
+*/
+void GSM_Usage::load(int address) {
+#if defined(GSM_EEPROM_ADDRESS)
+  if (isLoaded) return;
+  isLoaded = true;
+  if (EEPROM.read(address) != GSM_USAGE_SAVED) return;
+
+  EEPROM.get(address + 1, monthNumber);
+  EEPROM.get(address + 3, month);
+  savedTotal = getMonthlyTotal();
+  savedSMS = month.smsParts;
+#endif
+}
+
+/*
+  Saves the monthly totals to EEPROM, only changed bytes are written.
+*/
+void GSM_Usage::save(int address) {
+#if defined(GSM_EEPROM_ADDRESS)
+  EEPROM.update(address, GSM_USAGE_SAVED);
+  EEPROM.put(address + 1, monthNumber);
+  EEPROM.put(address + 3, month);
+#endif
+}
@@ -0,0 +1,67 @@
+#ifndef _GSM_Usage_h
+#define _GSM_Usage_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// Bytes of IP and TCP header in each packet
+#define GSM_TCP_HEADER 40
+// Most data sent in one TCP segment
+#define GSM_TCP_SEGMENT 1460
+// Packets opening (3) and closing (4) a TCP connection
+#define GSM_TCP_CONNECTION_PACKETS 7
+// Bytes used before the monthly totals are worth saving again
+#define GSM_USAGE_SAVE_RATE 1024
+
+// Data sent and received, see GSM_A6::getDataUsage()
+struct GSM_DataUsage {
+  uint32_t bytesSent;     // TCP data sent, without headers
+  uint32_t bytesReceived; // TCP data received, as reported by +CIPRCV
+  uint32_t overhead;      // Estimated IP and TCP headers sent and received
+  uint16_t segments;      // Estimated TCP segments sent
+  uint16_t connections;   // TCP connections opened
+  uint16_t smsParts;      // SMS sent, counting each part of a long message
+};
+
+/*
+  Counts the data the GSM sends and receives, both since the GSM was
+  created and for the month, so it can be kept within a budget. The
+  network only charges for what it carries, so the headers of each
+  packet are estimated from the data and connections: a header for each
+  segment sent and its acknowledgement, each segment received and its
+  acknowledgement, and the packets opening and closing each connection.
+*/
+class GSM_Usage {
+public:
+  GSM_Usage();
+
+  void addSent(uint32_t bytes);
+  void addReceived(uint32_t bytes);
+  void addConnection();
+  void addSMS(uint32_t characters);
+  bool update(uint32_t time);
+
+  bool isOverBudget(bool isSMS);
+  uint32_t getMonthlyTotal();
+
+  GSM_DataUsage session; // Since the GSM was created
+  GSM_DataUsage month;   // Since the start of the month, or since first used if the month isn't known
+  uint32_t budget;       // Most bytes each month including headers, 0 for no limit
+  uint16_t smsBudget;    // Most SMS parts each month, 0 for no limit
+
+  void load(int address);
+  void save(int address);
+
+private:
+  uint16_t monthNumber;  // Month counted, see GSM_monthOf(), 0 if not known
+  uint32_t savedTotal;   // Monthly total last saved
+  uint16_t savedSMS;
+  bool isLoaded;
+
+  void add(uint32_t sent, uint32_t received, uint32_t overhead, uint16_t segments, uint16_t connections, uint16_t smsParts);
+};
+
+#endif
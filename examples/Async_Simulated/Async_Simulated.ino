@@ -0,0 +1,113 @@
+#include <GSM_A6.h>
+#include <GSM_Simulator.h>
+
+/*
+  Checks that bringing up the GSM and uploading in the background
+  leaves the sketch free, by running them against a simulated GSM
+  while a sensor is sampled every 100ms. No GSM needs to be connected.
+  Each check is printed with PASS or FAIL, along with the latest any
+  sample was taken and the longest poll() took.
+
+  With #define GSM_VIRTUAL_CLOCK uncommented in GSM_A6.h this runs in
+  about a second, otherwise it takes about 30 seconds. The samples are
+  timed with the driver's clock, which gives the time they would have
+  been taken on a device. poll() is timed with micros(), the board's
+  own clock, because the virtual clock only moves when the driver
+  waits for the GSM, not while it is working.
+*/
+
+#define SAMPLE_INTERVAL 100
+#define SAMPLE_DEADLINE 10 // Most time in milliseconds a sample can be late
+
+#if defined(GSM_VIRTUAL_CLOCK)
+GSM_VirtualClock virtualClock;
+#endif
+
+GSM_Simulator simulator;
+GSM_A6 gsm = GSM_A6(simulator);
+
+bool isFinished = false;
+bool isSuccess = false;
+GSM_Operation finished;
+
+unsigned long nextSample = 0;
+unsigned long samples = 0;
+unsigned long latestSample = 0;
+unsigned long longestPoll = 0;
+uint8_t failures = 0;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ;
+  }
+
+#if defined(GSM_VIRTUAL_CLOCK)
+  // Each read of the clock counts as 10us, about what millis() takes on a device
+  virtualClock.tick = 10;
+  GSM_useClock(virtualClock);
+#endif
+  randomSeed(1);
+  simulator.latency = 100;
+  simulator.jitter = 50;
+
+  gsm.onComplete(gsmFinished);
+  nextSample = GSM_millis();
+
+  check(F("Bring up started"), gsm.beginBringUp(F("everywhere"), F("eesecure"), F("secure")));
+  runUntilFinished();
+  check(F("Bring up succeeded"), finished == GSM_CONNECT_TO_APN && isSuccess);
+
+  check(F("Upload started"), gsm.beginGetRequest(F("api.pushingbox.com"), F("/pushingbox?devid=vB5C666821EA7EAF&T=24.2")));
+  runUntilFinished();
+  check(F("Upload succeeded"), finished == GSM_GET_REQUEST && isSuccess);
+
+  Serial.print(F("Samples: "));
+  Serial.println(samples);
+  Serial.print(F("Latest sample (ms): "));
+  Serial.println(latestSample);
+  Serial.print(F("Longest poll (us): "));
+  Serial.println(longestPoll);
+  check(F("Every sample on time"), latestSample <= SAMPLE_DEADLINE);
+  check(F("Every poll() returned straight away"), longestPoll <= SAMPLE_DEADLINE * 1000UL);
+
+  Serial.print(failures);
+  Serial.println(F(" failed"));
+}
+
+void loop() {
+
+}
+
+/*
+  Polls the GSM and samples the sensor until the operation finishes,
+  recording how late each sample is and how long each poll() takes.
+*/
+void runUntilFinished() {
+  isFinished = false;
+  while (!isFinished) {
+    unsigned long start = micros();
+    gsm.poll();
+    unsigned long taken = micros() - start;
+    if (taken > longestPoll) longestPoll = taken;
+
+    unsigned long now = GSM_millis();
+    if ((long) (now - nextSample) >= 0) {
+      if (now - nextSample > latestSample) latestSample = now - nextSample;
+      nextSample += SAMPLE_INTERVAL;
+      ++samples;
+    }
+  }
+}
+
+void gsmFinished(GSM_A6 & gsm, GSM_Operation operation, bool success) {
+  isFinished = true;
+  finished = operation;
+  isSuccess = success;
+}
+
+void check(const __FlashStringHelper * name, bool passed) {
+  Serial.print(passed ? F("PASS ") : F("FAIL "));
+  Serial.println(name);
+  if (!passed) ++failures;
+}
@@ -0,0 +1,61 @@
+#include <GSM_A6.h>
+
+/*
+  Brings up the GSM and uploads a reading in the background,
+  so the sensor can still be read every 100ms while waiting for
+  the GSM. poll() must be called frequently from loop().
+
+  Ensure you are using a GSM with the correct firmware
+  and GSM A6 only.
+*/
+
+#define GSM_GND 4
+#define GSM_RESET_PIN 17
+#define SENSOR_PIN A0
+
+GSM_A6 gsm = GSM_A6(Serial, GSM_RESET_PIN, GSM_GND);
+
+bool isConnected = false;
+bool isUploading = false;
+unsigned long lastSample = 0;
+int reading = 0;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ;
+  }
+
+  gsm.setPower(true);
+  gsm.reset();
+
+  gsm.onComplete(gsmFinished);
+  gsm.beginBringUp(F("everywhere"), F("eesecure"), F("secure"));
+}
+
+void loop() {
+  gsm.poll();
+
+  if (millis() - lastSample >= 100) {
+    lastSample = millis();
+    reading = analogRead(SENSOR_PIN);
+  }
+
+  if (isConnected && !isUploading) {
+    // Fails while the GSM is busy, such as recovering after it stopped working
+    isUploading = gsm.beginGetRequest(F("api.pushingbox.com"), "/pushingbox?devid=vB5C666821EA7EAF&ID=2&T=" + String(reading));
+  }
+}
+
+/*
+  Called by the GSM when a background operation has finished,
+  GSM_RECOVER is reported once the GSM has been reset and brought
+  back up after it stopped working
+*/
+void gsmFinished(GSM_A6 & gsm, GSM_Operation operation, bool success) {
+  if (operation == GSM_GET_REQUEST) {
+    isUploading = false;
+  } else {
+    isConnected = success;
+  }
+}
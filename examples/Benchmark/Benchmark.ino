@@ -0,0 +1,164 @@
+#include <GSM_A6.h>
+#include <GSM_Simulator.h>
+
+/*
+  Measures each part of the library against a simulated GSM, no GSM
+  needs to be connected. Each call is printed as a line of JSON:
+    {"api":"getRequest","ok":1,"ms":1093,"heap":84,"stack":212}
+  ms is the time the call took on the device. On AVR boards heap and
+  stack are the most memory the call used, found by filling the free
+  memory with a pattern beforehand and looking for what was overwritten.
+  The metrics are printed last, then {"done":1}.
+
+  extras/benchmark.py builds the examples to report their size, and
+  uploads this one to collect the results into a report which can be
+  compared between versions of the library.
+
+  With #define GSM_VIRTUAL_CLOCK uncommented in GSM_A6.h this runs in
+  about a second, otherwise it takes about a minute.
+*/
+
+#if defined(GSM_VIRTUAL_CLOCK)
+GSM_VirtualClock virtualClock;
+#endif
+
+GSM_Simulator simulator;
+GSM_A6 gsm = GSM_A6(simulator);
+
+unsigned long start;
+
+#if defined(__AVR__)
+#define MEMORY_PATTERN 0xA5
+
+extern char __heap_start;
+extern char * __brkval;
+
+char * patternStart;
+char * patternEnd;
+
+/*
+  Fills the free memory between the heap and the stack with the pattern,
+  leaving room for the calls made before the one being measured.
+*/
+void fillMemory() {
+  char top;
+  patternStart = __brkval != NULL ? __brkval : &__heap_start;
+  patternEnd = &top - 32;
+  for (char * c = patternStart; c < patternEnd; ++c) *c = MEMORY_PATTERN;
+}
+
+/*
+  The longest run of the pattern left is memory which wasn't used,
+  the heap grew up to it and the stack grew down to it.
+*/
+void printMemory() {
+  char * gapStart = patternEnd;
+  char * gapEnd = patternEnd;
+  char * runStart = patternStart;
+
+  for (char * c = patternStart; c <= patternEnd; ++c) {
+    if (c < patternEnd && *c == MEMORY_PATTERN) continue;
+    if (c - runStart > gapEnd - gapStart) {
+      gapStart = runStart;
+      gapEnd = c;
+    }
+    runStart = c + 1;
+  }
+
+  Serial.print(F(",\"heap\":"));
+  Serial.print(gapStart - patternStart);
+  Serial.print(F(",\"stack\":"));
+  Serial.print(patternEnd - gapEnd);
+}
+#endif
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+    ;
+  }
+
+#if defined(GSM_VIRTUAL_CLOCK)
+  GSM_useClock(virtualClock);
+#endif
+
+  // The same every run, so versions of the library can be compared
+  simulator.latency = 100;
+  simulator.registerTime = 3000;
+  randomSeed(1);
+
+  begin(F("init"));
+  end(gsm.init());
+
+  begin(F("waitForNetwork"));
+  end(gsm.waitForNetwork());
+
+  begin(F("connectToAPN"));
+  end(gsm.connectToAPN(F("everywhere"), F("eesecure"), F("secure")));
+
+  begin(F("getSignalStrength"));
+  end(gsm.getSignalStrength() != NOT_KNOWN);
+
+  begin(F("syncClock"));
+  end(gsm.syncClock());
+
+  begin(F("getRequest"));
+  end(gsm.getRequest(F("api.pushingbox.com"), "/pushingbox?devid=vB5C666821EA7EAF&T=" + String(24.2)));
+
+  begin(F("startTCPConnection"));
+  end(sendByTCP());
+
+  gsm.useDnsCache(true);
+  gsm.getRequest(F("api.pushingbox.com"), F("/pushingbox?devid=vB5C666821EA7EAF"));
+  begin(F("getRequestCached"));
+  end(gsm.getRequest(F("api.pushingbox.com"), F("/pushingbox?devid=vB5C666821EA7EAF")));
+
+  begin(F("quickSMS"));
+  end(gsm.quickSMS(F("+447700900123"), "Temperature " + String(24.2)));
+
+  begin(F("sleep"));
+  end(gsm.sleep());
+
+  begin(F("wake"));
+  end(gsm.wake());
+
+  gsm.printMetrics(Serial);
+  Serial.println(F("{\"done\":1}"));
+}
+
+void loop() {
+
+}
+
+// Same request as getRequest(), written straight to the GSM without Strings
+bool sendByTCP() {
+  if (!gsm.startTCPConnection(F("api.pushingbox.com"))) return false;
+  Print & connection = gsm.getConnection();
+  connection.print(F("GET /pushingbox?devid=vB5C666821EA7EAF&T="));
+  connection.print(24.2);
+  connection.print(F(" HTTP/1.1\r\nHost: api.pushingbox.com\r\nConnection: close\r\n\r\n"));
+  return gsm.closeTCPConnection();
+}
+
+void begin(const __FlashStringHelper * api) {
+  Serial.print(F("{\"api\":\""));
+  Serial.print(api);
+  Serial.print('"');
+  Serial.flush();
+#if defined(__AVR__)
+  fillMemory();
+#endif
+  start = GSM_millis();
+}
+
+void end(bool success) {
+  unsigned long time = GSM_millis() - start;
+#if defined(__AVR__)
+  printMemory();
+#endif
+  Serial.print(F(",\"ok\":"));
+  Serial.print(success);
+  Serial.print(F(",\"ms\":"));
+  Serial.print(time);
+  Serial.println('}');
+}
@@ -0,0 +1,147 @@
+#include <GSM_A6.h>
+#include <GSM_Simulator.h>
+
+/*
+  Checks that messages arriving while deleteProcessedSMS() is deleting
+  aren't lost, using a simulated GSM. No GSM needs to be connected.
+  One message arrives just as the GSM is told to delete (+CMGD) and
+  another just as the messages are listed again afterwards, when it
+  can take an index which was freed. A message which isn't a command
+  must only be read (+CMGR) once. Each check is printed with PASS or
+  FAIL, then the number that failed.
+*/
+
+/*
+  Passes everything between the driver and the simulated GSM,
+  and has a message arrive as soon as the given command is sent,
+  or with arriveAfter() as soon as the command after it is sent.
+*/
+class ArrivingSMS : public Stream {
+public:
+  ArrivingSMS(GSM_Simulator & simulator)
+    : reads(0), simulator(simulator), trigger(NULL), text(NULL), isAfter(false), length(0) { }
+
+  uint8_t reads; // Messages read with +CMGR
+
+  void arriveOn(const char * command, const char * message) {
+    trigger = command;
+    text = message;
+    isAfter = false;
+  }
+
+  void arriveAfter(const char * command, const char * message) {
+    arriveOn(command, message);
+    isAfter = true;
+  }
+
+  bool hasArrived() {
+    return text == NULL;
+  }
+
+  int available() { return simulator.available(); }
+  int read() { return simulator.read(); }
+  int peek() { return simulator.peek(); }
+  void flush() { simulator.flush(); }
+
+  size_t write(uint8_t c) {
+    if (c == '\r') {
+      line[length] = '\0';
+      length = 0;
+      if (strstr(line, "+CMGR=") != NULL) ++reads;
+      if (text != NULL && (trigger == NULL || strstr(line, trigger) != NULL)) {
+        if (isAfter) {
+          // Arrives with the next command
+          trigger = NULL;
+          isAfter = false;
+        } else {
+          simulator.receiveSMS("+447700900999", text);
+          text = NULL;
+        }
+      }
+    } else if (length < sizeof(line) - 1) {
+      line[length++] = c;
+    }
+    return simulator.write(c);
+  }
+  using Print::write;
+
+private:
+  GSM_Simulator & simulator;
+  const char * trigger; // NULL to arrive with the next command
+  const char * text;    // NULL once the message has arrived
+  bool isAfter;
+  char line[24];
+  uint8_t length;
+};
+
+void reading(GSM_A6 & gsm, const char * sender, const char * arguments);
+
+const char READING[] PROGMEM = "READING";
+
+const GSM_SmsCommand COMMANDS[] PROGMEM = {
+  { READING, reading, NULL },
+};
+
+GSM_Simulator simulator;
+ArrivingSMS arriving = ArrivingSMS(simulator);
+GSM_A6 gsm = GSM_A6(arriving);
+
+uint16_t readings = 0; // Bit for each reading handled
+uint8_t failures = 0;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ;
+  }
+
+  simulator.latency = 50;
+  simulator.registerTime = 0;
+  check(F("GSM initialised"), gsm.init());
+
+  simulator.receiveSMS("+447700900123", "READING 1");
+  simulator.receiveSMS("+447700900123", "READING 2");
+  simulator.receiveSMS("+447700900124", "READING 3");
+  check(F("Three messages handled"), gsm.handleSMSCommands(COMMANDS, 1) == 3);
+
+  // Arrives just before the GSM deletes
+  arriving.arriveOn("+CMGD", "READING 4");
+  check(F("Processed messages deleted"), gsm.deleteProcessedSMS() == 3);
+  check(F("Message arrived while deleting"), arriving.hasArrived());
+  check(F("Message arriving while deleting kept"), gsm.totalMessages() == 1);
+  check(F("Message arriving while deleting handled"), gsm.handleSMSCommands(COMMANDS, 1) == 1 && readings == 0x1E);
+
+  // Arrives just after the GSM deletes, taking an index which was freed
+  simulator.receiveSMS("+447700900123", "READING 5");
+  check(F("Next message handled"), gsm.handleSMSCommands(COMMANDS, 1) == 1);
+  arriving.arriveAfter("+CMGD", "READING 6");
+  check(F("Processed messages deleted"), gsm.deleteProcessedSMS() == 2);
+  check(F("Message arrived after deleting"), arriving.hasArrived());
+  check(F("Message arriving after deleting kept"), gsm.totalMessages() == 1);
+  check(F("Message arriving after deleting not processed"), gsm.deleteProcessedSMS() == 0);
+  check(F("Message arriving after deleting handled"), gsm.handleSMSCommands(COMMANDS, 1) == 1 && readings == 0x7E);
+
+  // Left for markSMSProcessed(), without being read every time
+  simulator.receiveSMS("+447700900123", "HELLO");
+  arriving.reads = 0;
+  check(F("Message which isn't a command not handled"), gsm.handleSMSCommands(COMMANDS, 1) == 0 && arriving.reads == 1);
+  check(F("Message which isn't a command not read again"), gsm.handleSMSCommands(COMMANDS, 1) == 0 && arriving.reads == 1);
+  check(F("Message which isn't a command kept"), gsm.deleteProcessedSMS() == 0);
+
+  Serial.print(failures);
+  Serial.println(F(" failed"));
+}
+
+void loop() {
+
+}
+
+void reading(GSM_A6 & gsm, const char * sender, const char * arguments) {
+  readings |= 1 << atoi(arguments);
+}
+
+void check(const __FlashStringHelper * name, bool passed) {
+  Serial.print(passed ? F("PASS ") : F("FAIL "));
+  Serial.println(name);
+  if (!passed) ++failures;
+}
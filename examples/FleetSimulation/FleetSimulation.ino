@@ -0,0 +1,204 @@
+#include <GSM_A6.h>
+#include <GSM_Simulator.h>
+
+/*
+  Runs a fleet of simulated GSMs in the background to load test
+  a server without any GSMs. Each device brings up its simulated
+  GSM and then makes a GET request every UPLOAD_RATE milliseconds.
+
+  The requests are written to Serial between #<device> and #end,
+  run extras/fleet_bridge.py to forward them to the server:
+    python3 extras/fleet_bridge.py --serial /dev/ttyUSB0 --port 8080
+  The bridge sends back how long the server took as #latency <device> <ms>,
+  or #failed <device> if it couldn't be reached.
+
+  A line starting with #stats is written every 10 seconds with the
+  requests per minute, successes, failures, a histogram of how long
+  the requests took on the simulated GSMs, a histogram of how long
+  the server took and the number of recoveries.
+
+  Limits:
+  - Only FLEET_SIZE devices are run, each needs about 1KB of RAM for its
+    GSM_A6 and GSM_Simulator, so 4 on a Mega and 32 on an ESP32. Load
+    testing with hundreds of devices is done with the Linux build in
+    extras/host instead.
+  - Everything goes through one serial port at 115200 baud, which carries
+    about 70 requests a second at most.
+  - The simulated GSMs reply to the driver themselves, so the latency
+    histogram only shows the simulated network. The server's own latency
+    is only known when the bridge is run with --serial.
+*/
+
+#if defined(ESP32)
+#define FLEET_SIZE 32
+#else
+#define FLEET_SIZE 4
+#endif
+
+#define UPLOAD_RATE 5000
+#define STATS_RATE 10000
+
+// Upper bound in milliseconds of each bucket in the histogram, the last is everything slower
+const unsigned long LATENCY_BUCKETS[] = { 250, 500, 1000, 2000, 5000 };
+#define BUCKET_COUNT (sizeof(LATENCY_BUCKETS) / sizeof(LATENCY_BUCKETS[0]) + 1)
+
+GSM_Simulator simulators[FLEET_SIZE];
+GSM_A6 * fleet[FLEET_SIZE];
+
+bool isConnected[FLEET_SIZE];
+unsigned long requestStart[FLEET_SIZE]; // 0 when not uploading
+unsigned long lastUpload[FLEET_SIZE];
+
+unsigned long succeeded = 0;
+unsigned long failed = 0;
+unsigned long histogram[BUCKET_COUNT];
+unsigned long serverHistogram[BUCKET_COUNT];
+unsigned long serverFailed = 0;
+unsigned long lastStats = 0;
+unsigned long statsRequests = 0;
+
+char reply[24]; // Line sent back by the bridge
+uint8_t replyLength = 0;
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+    ;
+  }
+
+  for (uint8_t i = 0; i < FLEET_SIZE; ++i) {
+    // A mix of good and poor devices
+    simulators[i].latency = 20 + 10 * (i % 4);
+    simulators[i].jitter = 50;
+    simulators[i].registerTime = 2000 + 500 * i;
+    simulators[i].errorRate = i % 4 == 3 ? 5 : 0;
+    simulators[i].bridgeTo(Serial, i);
+
+    fleet[i] = new GSM_A6(simulators[i]);
+    fleet[i]->onComplete(gsmFinished);
+    fleet[i]->beginBringUp(F("everywhere"), F("eesecure"), F("secure"));
+  }
+}
+
+void loop() {
+  for (uint8_t i = 0; i < FLEET_SIZE; ++i) {
+    fleet[i]->poll();
+
+    if (isConnected[i] && requestStart[i] == 0 && millis() - lastUpload[i] >= UPLOAD_RATE) {
+      lastUpload[i] = millis();
+      if (fleet[i]->beginGetRequest(F("localhost"), "/reading?device=" + String(i) + "&T=" + String(random(100)))) {
+        requestStart[i] = millis();
+      }
+    }
+  }
+
+  readBridge();
+
+  if (millis() - lastStats >= STATS_RATE) {
+    printStats();
+  }
+}
+
+/*
+  Reads the server latency sent back by extras/fleet_bridge.py,
+  a line at a time without waiting.
+*/
+void readBridge() {
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c != '\n') {
+      if (replyLength < sizeof(reply) - 1) reply[replyLength++] = c;
+      continue;
+    }
+
+    reply[replyLength] = '\0';
+    replyLength = 0;
+
+    if (strncmp_P(reply, PSTR("#latency "), 9) == 0) {
+      // #latency <device> <ms>
+      char * time = strchr(reply + 9, ' ');
+      if (time != NULL) addToHistogram(serverHistogram, strtoul(time + 1, NULL, 10));
+    } else if (strncmp_P(reply, PSTR("#failed "), 8) == 0) {
+      ++serverFailed;
+    }
+  }
+}
+
+void addToHistogram(unsigned long * counts, unsigned long time) {
+  uint8_t bucket = 0;
+  while (bucket < BUCKET_COUNT - 1 && time > LATENCY_BUCKETS[bucket]) ++bucket;
+  ++counts[bucket];
+}
+
+uint8_t findDevice(GSM_A6 & gsm) {
+  for (uint8_t i = 0; i < FLEET_SIZE; ++i) {
+    if (fleet[i] == &gsm) return i;
+  }
+  return 0;
+}
+
+/*
+  Called by each simulated GSM when a background operation has finished
+*/
+void gsmFinished(GSM_A6 & gsm, GSM_Operation operation, bool success) {
+  uint8_t i = findDevice(gsm);
+
+  if (operation != GSM_GET_REQUEST) {
+    isConnected[i] = success;
+    return;
+  }
+
+  unsigned long time = millis() - requestStart[i];
+  requestStart[i] = 0;
+  ++statsRequests;
+
+  if (!success) {
+    ++failed;
+    return;
+  }
+
+  ++succeeded;
+  addToHistogram(histogram, time);
+}
+
+void printStats() {
+  unsigned long elapsed = millis() - lastStats;
+  lastStats = millis();
+
+  uint16_t recoveries = 0;
+  for (uint8_t i = 0; i < FLEET_SIZE; ++i) {
+    recoveries += fleet[i]->getMetrics().recoveries;
+  }
+
+  Serial.print(F("#stats perMinute="));
+  Serial.print(statsRequests * 60000UL / elapsed);
+  Serial.print(F(" ok="));
+  Serial.print(succeeded);
+  Serial.print(F(" failed="));
+  Serial.print(failed);
+  Serial.print(F(" recoveries="));
+  Serial.print(recoveries);
+  Serial.print(F(" latency="));
+  printHistogram(histogram);
+  Serial.print(F(" server="));
+  printHistogram(serverHistogram);
+  Serial.print(F(" serverFailed="));
+  Serial.println(serverFailed);
+
+  statsRequests = 0;
+}
+
+void printHistogram(unsigned long * counts) {
+  for (uint8_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+    if (bucket > 0) Serial.print(',');
+    if (bucket < BUCKET_COUNT - 1) {
+      Serial.print(F("<="));
+      Serial.print(LATENCY_BUCKETS[bucket]);
+    } else {
+      Serial.print('>');
+      Serial.print(LATENCY_BUCKETS[bucket - 1]);
+    }
+    Serial.print(':');
+    Serial.print(counts[bucket]);
+  }
+}
@@ -0,0 +1,51 @@
+#include <GSM_A6.h>
+
+/*
+  Uploads a reading every 5 minutes, with the GSM asleep in between
+  instead of switched off. The GSM stays registered with the network
+  and connected to the APN while asleep, so each upload starts within
+  a second rather than bringing the GSM up all over again.
+  See the PowerComparison example for the difference it makes.
+
+  Ensure you are using a GSM with the correct firmware
+  and GSM A6 only.
+*/
+
+#define GSM_GND 4
+#define GSM_RESET_PIN 17
+#define GSM_DTR 5
+#define SENSOR_PIN A0
+
+#define UPLOAD_RATE 300000L // 5 minutes
+
+GSM_A6 gsm = GSM_A6(Serial, GSM_RESET_PIN, GSM_GND);
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ;
+  }
+
+  gsm.useSleepPin(GSM_DTR);
+  bringUp();
+}
+
+void loop() {
+  unsigned long start = millis();
+
+  // Brought up again if the GSM lost the network while asleep
+  if (gsm.wake() || bringUp()) {
+    gsm.getRequest(F("api.pushingbox.com"), "/pushingbox?devid=vB5C666821EA7EAF&ID=2&T=" + String(analogRead(SENSOR_PIN)));
+  }
+  gsm.sleep();
+
+  while (millis() - start < UPLOAD_RATE) {
+    ;
+  }
+}
+
+bool bringUp() {
+  gsm.setPower(true);
+  gsm.reset();
+  return gsm.init() && gsm.waitForNetwork() && gsm.connectToAPN(F("everywhere"), F("eesecure"), F("secure"));
+}
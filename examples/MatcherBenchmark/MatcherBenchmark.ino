@@ -0,0 +1,85 @@
+#include <GSM_A6.h>
+
+/*
+  Compares the time GSM_ResponseMatcher takes to classify a line with
+  the indexOf() checks the library used before it. No GSM needs to be
+  connected. The average time for each line is printed in microseconds.
+
+  The indexOf() checks can be quicker on some boards, but they can only
+  start once the whole reply has been read into a String, which meant
+  waiting for readString() to time out (a second) on every command.
+  The matcher is given each character as it arrives, at 9600 baud that
+  is about a millisecond apart, so its time is spread across the reply.
+  It also finds +CME ERROR: and +CMS ERROR: and a match at the start of
+  the line, which the indexOf() checks missed, and uses no heap.
+*/
+
+#define REPEATS 1000
+
+const char * const lines[] = {
+  "OK",
+  "+CREG: 1,1",
+  "+CME ERROR: Unknown error",
+  "STATE: IP GPRSACT",
+  "+CSQ: 21,0",
+  "CONNECT OK",
+  "10.0.0.1",
+  "ERROR",
+};
+const uint8_t lineCount = sizeof(lines) / sizeof(lines[0]);
+
+GSM_ResponseMatcher matcher;
+volatile uint8_t result;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ;
+  }
+
+  unsigned long start = micros();
+  for (uint16_t i = 0; i < REPEATS; ++i) {
+    for (uint8_t line = 0; line < lineCount; ++line) {
+      result = matchLine(lines[line]);
+    }
+  }
+  printTime(F("Matcher (us/line): "), micros() - start);
+
+  start = micros();
+  for (uint16_t i = 0; i < REPEATS; ++i) {
+    for (uint8_t line = 0; line < lineCount; ++line) {
+      result = searchLine(lines[line]);
+    }
+  }
+  printTime(F("indexOf (us/line): "), micros() - start);
+}
+
+void loop() {
+
+}
+
+uint8_t matchLine(const char * line) {
+  matcher.begin("OK");
+  while (*line != '\0') {
+    matcher.add(*line++);
+  }
+  return matcher.result();
+}
+
+// The checks made on the reply before GSM_ResponseMatcher
+uint8_t searchLine(const char * line) {
+  String response = line;
+  if (response.indexOf("OK") > 0) return GSM_RESPONSE_EXPECTED;
+  if (response.indexOf("ERROR") > 0) {
+    if (response.indexOf("Excute command failure") > 0) return GSM_RESPONSE_COMMAND_FAILURE;
+    if (response.indexOf("Unknown error") > 0) return GSM_RESPONSE_UNKNOWN_ERROR;
+    if (response.indexOf("FATAL ERROR") > 0) return GSM_RESPONSE_FATAL_ERROR;
+    return GSM_RESPONSE_ERROR;
+  }
+  return GSM_RESPONSE_NONE;
+}
+
+void printTime(const __FlashStringHelper * name, unsigned long time) {
+  Serial.print(name);
+  Serial.println((float) time / ((unsigned long) REPEATS * lineCount), 3);
+}
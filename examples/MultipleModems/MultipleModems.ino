@@ -0,0 +1,73 @@
+#include <GSM_A6.h>
+#include <GSM_Pool.h>
+
+/*
+  Uses two GSMs with SIM Cards from different networks on a board
+  with more than one hardware serial port (such as the Mega).
+  Uploads are sent through the GSM with the best signal, if it
+  fails the other GSM is used instead.
+
+  Ensure you are using a GSM with the correct firmware
+  and GSM A6 only.
+*/
+
+#define GSM1_GND 4
+#define GSM1_RESET_PIN 17
+#define GSM2_GND 5
+#define GSM2_RESET_PIN 18
+
+GSM_A6 gsm1 = GSM_A6(Serial1, GSM1_RESET_PIN, GSM1_GND);
+GSM_A6 gsm2 = GSM_A6(Serial2, GSM2_RESET_PIN, GSM2_GND);
+GSM_Pool pool;
+
+void setup() {
+  Serial.begin(9600);
+  Serial1.begin(9600);
+  Serial2.begin(9600);
+  while (!Serial) {
+    ;
+  }
+
+  if (configureGSM(gsm1, N_ASDA)) {
+    pool.add(gsm1);
+  } else {
+    Serial.println(F("Failed to configure GSM 1"));
+  }
+
+  if (configureGSM(gsm2, N_GIFFGAFF)) {
+    pool.add(gsm2);
+  } else {
+    Serial.println(F("Failed to configure GSM 2"));
+  }
+
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (pool.getRequest(F("api.pushingbox.com"), "/pushingbox?devid=vB5C666821EA7EAF&ID=2&T=24.2&H=14.8")) {
+      Serial.println(F("Sent"));
+    } else {
+      Serial.println(F("Failed to send"));
+    }
+  }
+
+  gsm1.setPower(false);
+  gsm2.setPower(false);
+}
+
+void loop() {
+
+}
+
+/*
+  Switches on and initialises a GSM Module by
+  configuring it's APN Settings
+*/
+bool configureGSM(GSM_A6 & gsm, uint8_t network) {
+  gsm.setPower(true);
+  gsm.reset();
+
+  if (!gsm.init()) return false;
+
+  if (!gsm.waitForNetwork()) return false;
+  delay(1000);
+
+  return gsm.setMobileNetwork(network);
+}
@@ -0,0 +1,113 @@
+#include <GSM_A6.h>
+#include <GSM_Simulator.h>
+
+/*
+  Compares two ways of saving power between uploads using a simulated
+  GSM, no GSM needs to be connected:
+    Power cycling - switching the GSM off, then on, init(), waitForNetwork()
+                    and connectToAPN() before each upload
+    Sleeping      - sleep() between uploads, then wake() before each upload
+
+  For each the mean time from starting to wake to the upload finishing
+  and the mean current are printed. The currents and times used by the
+  simulator can be changed below to match your GSM and network.
+
+  With #define GSM_VIRTUAL_CLOCK uncommented in GSM_A6.h this runs in about
+  a second, otherwise it takes CYCLES * UPLOAD_RATE for each way.
+*/
+
+#define GSM_GND 4
+#define GSM_RESET_PIN 17
+#define GSM_DTR 5
+
+#define UPLOAD_RATE 300000L // 5 minutes
+#define CYCLES 12
+
+#if defined(GSM_VIRTUAL_CLOCK)
+GSM_VirtualClock virtualClock;
+#endif
+
+GSM_Simulator simulator;
+GSM_A6 gsm = GSM_A6(simulator, GSM_RESET_PIN, GSM_GND);
+
+unsigned long totalLatency;
+unsigned long failures;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ;
+  }
+
+#if defined(GSM_VIRTUAL_CLOCK)
+  GSM_useClock(virtualClock);
+#endif
+
+  simulator.powerPin = GSM_GND;
+  simulator.resetPin = GSM_RESET_PIN;
+  simulator.dtrPin = GSM_DTR;
+  simulator.latency = 100;
+  simulator.registerTime = 15000;
+  simulator.sleepCurrent = 3;
+  simulator.idleCurrent = 20;
+  simulator.busyCurrent = 150;
+
+  compare(F("Power cycling"), false);
+  compare(F("Sleeping"), true);
+}
+
+void loop() {
+
+}
+
+bool bringUp() {
+  gsm.setPower(true);
+  gsm.reset();
+  return gsm.init() && gsm.waitForNetwork() && gsm.connectToAPN(F("everywhere"), F("eesecure"), F("secure"));
+}
+
+void compare(const __FlashStringHelper * name, bool isSleeping) {
+  totalLatency = 0;
+  failures = 0;
+
+  if (isSleeping) {
+    gsm.useSleepPin(GSM_DTR);
+    if (!bringUp() || !gsm.sleep()) ++failures;
+  }
+
+  unsigned long startCharge = simulator.getCharge();
+  unsigned long start = GSM_millis();
+
+  for (uint8_t i = 0; i < CYCLES; ++i) {
+    unsigned long cycleStart = GSM_millis();
+
+    bool isReady = isSleeping ? gsm.wake() || bringUp() : bringUp();
+    if (!isReady || !gsm.getRequest(F("api.pushingbox.com"), F("/pushingbox?devid=vB5C666821EA7EAF"))) ++failures;
+    totalLatency += GSM_millis() - cycleStart;
+
+    if (isSleeping) {
+      gsm.sleep();
+    } else {
+      gsm.setPower(false);
+    }
+
+    unsigned long elapsed = GSM_millis() - cycleStart;
+    if (elapsed < UPLOAD_RATE) GSM_delay(UPLOAD_RATE - elapsed);
+  }
+
+  unsigned long time = GSM_millis() - start;
+  unsigned long charge = simulator.getCharge() - startCharge;
+
+  Serial.print(name);
+  Serial.print(F(": upload took "));
+  Serial.print(totalLatency / CYCLES);
+  Serial.print(F("ms, mean current "));
+  Serial.print((float) charge * 1000 / time, 2);
+  Serial.print(F("mA, failures "));
+  Serial.println(failures);
+  if (isSleeping) {
+    Serial.print(F("  last wake took "));
+    Serial.print(gsm.getMetrics().wakeTime);
+    Serial.println(F("ms"));
+  }
+}
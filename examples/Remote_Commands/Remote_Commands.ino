@@ -0,0 +1,61 @@
+#include <GSM_A6.h>
+
+/*
+  Changes settings by SMS. Send "RATE 10" from an allowed phone
+  to upload every 10 minutes, or "STATUS" from any phone to get
+  a reply with the current settings.
+
+  Ensure you are using a GSM with the correct firmware
+  and GSM A6 only.
+*/
+
+#define GSM_GND 4
+#define GSM_RESET_PIN 17
+
+GSM_A6 gsm = GSM_A6(Serial, GSM_RESET_PIN, GSM_GND);
+
+unsigned long uploadRate = 5; // Minutes
+
+void setRate(GSM_A6 & gsm, const char * sender, const char * arguments);
+void sendStatus(GSM_A6 & gsm, const char * sender, const char * arguments);
+
+// Phone numbers as the GSM reports them, starting with the country code
+const char OWNER[] PROGMEM = "+447700900123";
+const char * const OWNERS[] PROGMEM = { OWNER, NULL };
+
+const char RATE[] PROGMEM = "RATE";
+const char STATUS[] PROGMEM = "STATUS";
+
+const GSM_SmsCommand COMMANDS[] PROGMEM = {
+  { RATE, setRate, OWNERS },
+  { STATUS, sendStatus, NULL },
+};
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ;
+  }
+
+  gsm.setPower(true);
+  gsm.reset();
+
+  if (!gsm.init() || !gsm.waitForNetwork()) {
+    gsm.setPower(false);
+  }
+}
+
+void loop() {
+  // Messages are only deleted once every message has been handled
+  gsm.handleSMSCommands(COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]), true);
+  delay(30000);
+}
+
+void setRate(GSM_A6 & gsm, const char * sender, const char * arguments) {
+  unsigned long rate = atol(arguments);
+  if (rate > 0) uploadRate = rate;
+}
+
+void sendStatus(GSM_A6 & gsm, const char * sender, const char * arguments) {
+  gsm.quickSMS(sender, "Uploading every " + String(uploadRate) + " minutes");
+}
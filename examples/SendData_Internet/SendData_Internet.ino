@@ -60,44 +60,43 @@ void loop() {
 }
 
 // Due to the addition of string more memory is used
+// Failed requests are made again as set by gsm.getRetryPolicy()
 bool sendData(const String & data) {
-  bool successful = false;
-  uint8_t counter = 0;
-  while (!successful && counter < 2) {
-    successful = gsm.getRequest(F("api.pushingbox.com"), "/pushingbox?devid=vB5C666821EA7EAF&ID=2&T=24.2&H=14.8&dt=09:10:00%2002/07/2018");
-    ++counter;
-  }
-  return successful;
+  String resource = "/pushingbox?devid=vB5C666821EA7EAF&ID=2&T=24.2&H=14.8";
+  uint32_t time = gsm.getTime(); // 0 until the clock is synced
+  if (time != 0) resource += "&dt=" + String(time);
+  return gsm.getRequest(F("api.pushingbox.com"), resource);
 }
 
 // Saves memory
+// Failed connections and closes are made again as set by gsm.getRetryPolicy(),
+// a failed close doesn't send the data again
 bool sendData2(const String & data) {
-  bool successful = false;
-  uint8_t counter = 0;
-  while (!successful && counter < 2) {
-    successful = gsm.startTCPConnection(F("api.pushingbox.com")); // Server
-    if (successful) {
-      Serial.print(F("GET "));
-      Serial.print(F("/pushingbox?devid=vB5C666821EA7EAF&")); // resource
-      Serial.print("ID=");
-      Serial.print(2);
-      Serial.print("&T=");
-      Serial.print(24.2);
-      Serial.print("&H=");
-      Serial.print(14.8);
-      Serial.print("&dt=09:10:00%2002/07/2018");
-
-      Serial.print(F(" HTTP/1.1\r\n"));
-      Serial.print(F("Host: "));
-      Serial.print(F("api.pushingbox.com"));
-      Serial.print(F("\r\n"));
-      Serial.print(F("Connection: close\r\n\r\n"));
-
-      successful = gsm.closeTCPConnection();
-    }
-    ++counter;
+  if (!gsm.startTCPConnection(F("api.pushingbox.com"))) return false; // Server
+
+  // Written to the GSM and counted in gsm.getDataUsage()
+  Print & connection = gsm.getConnection();
+  connection.print(F("GET "));
+  connection.print(F("/pushingbox?devid=vB5C666821EA7EAF&")); // resource
+  connection.print("ID=");
+  connection.print(2);
+  connection.print("&T=");
+  connection.print(24.2);
+  connection.print("&H=");
+  connection.print(14.8);
+  uint32_t time = gsm.getTime(); // Seconds since 1970, 0 until the clock is synced
+  if (time != 0) {
+    connection.print("&dt=");
+    connection.print(time);
   }
-  return successful;
+
+  connection.print(F(" HTTP/1.1\r\n"));
+  connection.print(F("Host: "));
+  connection.print(F("api.pushingbox.com"));
+  connection.print(F("\r\n"));
+  connection.print(F("Connection: close\r\n\r\n"));
+
+  return gsm.closeTCPConnection();
 }
 
 /*
@@ -135,6 +134,8 @@ bool configureGSM() {
   if (!gsm.init()) return false;
 
   if (!gsm.waitForNetwork()) return false;
+  // Time the readings are taken, they are sent without it if this fails
+  if (!gsm.syncClock()) Serial.println("Failed to get the time from the network");
   delay(1000);
 
   return gsm.setMobileNetwork(N_ASDA);
@@ -62,15 +62,17 @@ void loop() {
 
 }
 
-void sendData(const String & phoneNo, const String & data) {
-  gsm.quickSMS(phoneNo, data);
+// Returns false if the SMS budget has been spent
+bool sendData(const String & phoneNo, const String & data) {
+  return gsm.quickSMS(phoneNo, data);
 }
 
 void sendData2(const String & phoneNo, const String & data) {
   if (gsm.startSMS()) {
-    Serial.print(phoneNo);
+    Print & connection = gsm.getConnection(); // Counted in gsm.getDataUsage()
+    connection.print(phoneNo);
     gsm.enterSMSContent();
-    Serial.print(data);
+    connection.print(data);
     gsm.sendSMS();
   }
 }
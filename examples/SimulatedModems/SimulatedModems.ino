@@ -0,0 +1,114 @@
+#include <GSM_A6.h>
+#include <GSM_Pool.h>
+#include <GSM_Simulator.h>
+
+/*
+  Checks that several GSMs can be used at once, by running three
+  simulated GSMs together in a pool. No GSM needs to be connected.
+  Each check is printed with PASS or FAIL, then the number that failed.
+
+  The pool picks the GSM with the best signal, moves on to the next
+  GSM when one stops answering and only fails once they all have.
+  Each GSM keeps its own state, so a broken GSM doesn't affect the others.
+
+  With #define GSM_VIRTUAL_CLOCK uncommented in GSM_A6.h this runs in
+  about a second, otherwise the GSMs which don't answer take a few minutes.
+*/
+
+// Counts the data each simulated GSM sends over TCP
+class DataCounter : public Print {
+public:
+  DataCounter() : bytes(0) { }
+  size_t write(uint8_t c) {
+    ++bytes;
+    return 1;
+  }
+  unsigned long bytes;
+};
+
+#if defined(GSM_VIRTUAL_CLOCK)
+GSM_VirtualClock virtualClock;
+#endif
+
+GSM_Simulator simulator1;
+GSM_Simulator simulator2;
+GSM_Simulator simulator3;
+GSM_A6 gsm1 = GSM_A6(simulator1);
+GSM_A6 gsm2 = GSM_A6(simulator2);
+GSM_A6 gsm3 = GSM_A6(simulator3);
+DataCounter sent1;
+DataCounter sent2;
+DataCounter sent3;
+GSM_Pool pool;
+
+uint8_t failures = 0;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ;
+  }
+
+#if defined(GSM_VIRTUAL_CLOCK)
+  GSM_useClock(virtualClock);
+#endif
+  randomSeed(1);
+
+  simulator1.signal = 25;
+  simulator2.signal = 15;
+  simulator3.signal = 10;
+  simulator2.operatorCode = "23415";
+  simulator3.operatorCode = "23430";
+  simulator1.bridgeTo(sent1, 1);
+  simulator2.bridgeTo(sent2, 2);
+  simulator3.bridgeTo(sent3, 3);
+
+  check(F("GSM 1 configured"), configureGSM(gsm1));
+  check(F("GSM 2 configured"), configureGSM(gsm2));
+  check(F("GSM 3 configured"), configureGSM(gsm3));
+  pool.add(gsm1);
+  pool.add(gsm2);
+  pool.add(gsm3);
+
+  check(F("Best signal used first"), pool.next() == &gsm1);
+  check(F("Upload sent"), upload());
+  check(F("Upload sent by GSM 1 only"), sent1.bytes > 0 && sent2.bytes == 0 && sent3.bytes == 0);
+
+  // GSM 1 stops answering, the next best takes over
+  simulator1.silenceRate = 100;
+  unsigned long before1 = sent1.bytes;
+  check(F("Upload sent after GSM 1 failed"), upload());
+  check(F("Upload sent by GSM 2"), sent2.bytes > 0 && sent1.bytes == before1);
+  check(F("Failed GSM not used"), pool.next() == &gsm2);
+
+  // GSM 2 only answers with errors, it mustn't affect GSM 3
+  simulator2.errorRate = 100;
+  check(F("Upload sent after GSM 2 failed"), upload());
+  check(F("Upload sent by GSM 3"), sent3.bytes > 0);
+  check(F("GSM 3 still works on its own"), gsm3.getSignalStrengthRAW() == 10);
+
+  simulator3.silenceRate = 100;
+  check(F("Fails once every GSM has"), !upload());
+
+  Serial.print(failures);
+  Serial.println(F(" failed"));
+}
+
+void loop() {
+
+}
+
+bool configureGSM(GSM_A6 & gsm) {
+  return gsm.init() && gsm.waitForNetwork()
+    && gsm.connectToAPN(F("everywhere"), F("eesecure"), F("secure"));
+}
+
+bool upload() {
+  return pool.getRequest(F("api.pushingbox.com"), F("/pushingbox?devid=vB5C666821EA7EAF"));
+}
+
+void check(const __FlashStringHelper * name, bool passed) {
+  Serial.print(passed ? F("PASS ") : F("FAIL "));
+  Serial.println(name);
+  if (!passed) ++failures;
+}
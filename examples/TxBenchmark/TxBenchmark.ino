@@ -0,0 +1,126 @@
+#include <GSM_A6.h>
+
+/*
+  Compares the time the sketch is held up writing commands to the GSM
+  through GSM_TxBuffer with the way the library wrote them before it,
+  printing each part of the command and waiting with flush() after
+  every command. No GSM needs to be connected, the commands are written
+  to Serial1 at 9600 baud (Serial on boards without Serial1), which
+  takes the same time whether or not anything is listening.
+
+  The bring up commands are written one at a time with a pause after
+  each, as if waiting for the GSM to reply, and only the writing is
+  timed. The HTTP header of a GET request is then written in one go.
+  The average time for each command and the time for the header are
+  printed in microseconds, for both ways of writing.
+
+  The times depend on the board's serial buffer, commands shorter than
+  the buffer are only copied into it, longer ones wait for the rest
+  to be sent at 9600 baud either way.
+*/
+
+#define TX_BAUD_RATE 9600
+#define REPLY_WAIT 50 // Milliseconds between commands, as if the GSM was replying
+#define REPEATS 5
+
+#if defined(HAVE_HWSERIAL1) || defined(SERIAL_PORT_HARDWARE1)
+#define GSM_SERIAL Serial1
+#else
+#define GSM_SERIAL Serial
+#endif
+
+const char * const commands[] = {
+  "",
+  "&F0",
+  "E0",
+  "I",
+  "+CMEE=2",
+  "+CPMS=\"SM\",\"SM\",\"SM\"",
+  "+CMGF=1",
+  "+CTZU=1",
+  "+CREG=2",
+  "+CREG?",
+  "+CGATT=1",
+  "+CGDCONT=1,\"IP\",\"everywhere\"",
+  "+CSTT=\"everywhere\",\"eesecure\",\"secure\"",
+  "+CIICR",
+  "+CIFSR",
+  "+CIPSTART=\"TCP\",\"api.pushingbox.com\",80",
+};
+const uint8_t commandCount = sizeof(commands) / sizeof(commands[0]);
+
+GSM_TxBuffer tx = GSM_TxBuffer(GSM_SERIAL);
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ;
+  }
+  GSM_SERIAL.begin(TX_BAUD_RATE);
+
+  unsigned long unbuffered = 0;
+  unsigned long buffered = 0;
+  for (uint8_t i = 0; i < REPEATS; ++i) {
+    for (uint8_t command = 0; command < commandCount; ++command) {
+      unbuffered += writeUnbuffered(commands[command]);
+      delay(REPLY_WAIT);
+      buffered += writeBuffered(commands[command]);
+      delay(REPLY_WAIT);
+    }
+  }
+  printTime(F("Unbuffered (us/command): "), unbuffered / ((unsigned long) REPEATS * commandCount));
+  printTime(F("GSM_TxBuffer (us/command): "), buffered / ((unsigned long) REPEATS * commandCount));
+
+  unbuffered = 0;
+  buffered = 0;
+  for (uint8_t i = 0; i < REPEATS; ++i) {
+    unbuffered += writeHeader(GSM_SERIAL);
+    delay(REPLY_WAIT * 4);
+    buffered += writeHeader(tx);
+    delay(REPLY_WAIT * 4);
+  }
+  printTime(F("Unbuffered (us/header): "), unbuffered / REPEATS);
+  printTime(F("GSM_TxBuffer (us/header): "), buffered / REPEATS);
+}
+
+void loop() {
+
+}
+
+// The way commands were written before GSM_TxBuffer
+unsigned long writeUnbuffered(const char * command) {
+  unsigned long start = micros();
+  GSM_SERIAL.print(F("AT"));
+  GSM_SERIAL.print(command);
+  GSM_SERIAL.print(GSM_END);
+  GSM_SERIAL.flush();
+  return micros() - start;
+}
+
+unsigned long writeBuffered(const char * command) {
+  unsigned long start = micros();
+  tx.print(F("AT"));
+  tx.print(command);
+  tx.print(GSM_END);
+  tx.send();
+  return micros() - start;
+}
+
+// The header was written without flush() before GSM_TxBuffer too
+unsigned long writeHeader(Print & output) {
+  unsigned long start = micros();
+  output.print(F("GET "));
+  output.print(F("/pushingbox?devid=vB5C666821EA7EAF&T=24.2"));
+  output.print(F(" HTTP/1.1\r\n"));
+  output.print(F("Host: "));
+  output.print(F("api.pushingbox.com"));
+  output.print(F("\r\nConnection: close\r\n\r\n"));
+  output.write(0x1A);
+  tx.send(); // Nothing to send when written unbuffered
+  return micros() - start;
+}
+
+void printTime(const __FlashStringHelper * name, unsigned long time) {
+  Serial.print(name);
+  Serial.println(time);
+}
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Measures how much flash and RAM the examples use and how long each call takes.
+
+Builds every example with arduino-cli for each board given and records the
+flash and static RAM it uses. With --port the Benchmark example is also built
+with GSM_VIRTUAL_CLOCK defined and uploaded, and the time, heap and stack of
+each call it prints are collected. Boards which don't reset when the serial
+port is opened need resetting by hand once the upload finishes.
+
+The report is written as JSON, --compare prints the differences from an
+earlier report so versions of the library can be compared.
+
+    python3 benchmark.py --fqbn arduino:avr:mega --port /dev/ttyACM0 -o new.json --compare old.json
+"""
+
+import argparse
+import json
+import os
+import queue
+import re
+import subprocess
+import sys
+import threading
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+EXAMPLES = os.path.join(ROOT, "examples")
+
+
+def compile_sketch(fqbn, sketch, flags="", port=None):
+    """Builds the sketch, uploading it if a port is given.
+
+    Returns {"flash": bytes, "ram": bytes}, or {"error": message} if it failed.
+    """
+    command = ["arduino-cli", "compile", "--fqbn", fqbn, "--library", ROOT, sketch]
+    if flags:
+        command += ["--build-property", "compiler.cpp.extra_flags=" + flags]
+    if port:
+        command += ["--upload", "--port", port]
+
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                            universal_newlines=True)
+    if result.returncode != 0:
+        errors = [line for line in result.stdout.splitlines() if "error" in line.lower()]
+        return {"error": (errors or result.stdout.splitlines() or ["failed"])[0].strip()}
+
+    flash = re.search(r"Sketch uses (\d+) bytes", result.stdout)
+    ram = re.search(r"Global variables use (\d+) bytes", result.stdout)
+    return {"flash": int(flash.group(1)) if flash else None,
+            "ram": int(ram.group(1)) if ram else None}
+
+
+def collect(port, baud, timeout):
+    """Reads the lines of JSON printed by the Benchmark example until {"done":1}."""
+    monitor = subprocess.Popen(["arduino-cli", "monitor", "--port", port, "--quiet",
+                                "--config", "baudrate=%d" % baud],
+                               stdout=subprocess.PIPE, universal_newlines=True)
+    lines = queue.Queue()
+    threading.Thread(target=lambda: [lines.put(line) for line in monitor.stdout], daemon=True).start()
+
+    calls = {}
+    metrics = {}
+    end = time.monotonic() + timeout
+    try:
+        while time.monotonic() < end:
+            try:
+                line = lines.get(timeout=1).strip()
+            except queue.Empty:
+                continue
+            if not line.startswith("{"):
+                continue
+            try:
+                values = json.loads(line)
+            except ValueError:
+                continue
+
+            if "done" in values:
+                break
+            elif "api" in values:
+                calls[values.pop("api")] = values
+            else:
+                metrics = values
+        else:
+            print("Timed out waiting for the benchmark", file=sys.stderr)
+    finally:
+        monitor.terminate()
+
+    return {"calls": calls, "metrics": metrics}
+
+
+def version():
+    try:
+        return subprocess.check_output(["git", "-C", ROOT, "describe", "--always", "--dirty"],
+                                       universal_newlines=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def change(old, new):
+    if not isinstance(old, int) or not isinstance(new, int):
+        return "%s -> %s" % (old, new)
+    return "%d -> %d (%+d)" % (old, new, new - old)
+
+
+def compare(old, new):
+    """Prints every size and call which changed between the reports."""
+    print("Compared with %s" % old.get("version", "unknown"))
+    for fqbn, sketches in sorted(new["sizes"].items()):
+        for sketch, size in sorted(sketches.items()):
+            before = old.get("sizes", {}).get(fqbn, {}).get(sketch, {})
+            for field in ("flash", "ram"):
+                if before.get(field) != size.get(field):
+                    print("  %s %s %s: %s" % (fqbn, sketch, field, change(before.get(field), size.get(field))))
+
+    for fqbn, benchmark in sorted(new["benchmark"].items()):
+        for api, call in sorted(benchmark["calls"].items()):
+            before = old.get("benchmark", {}).get(fqbn, {}).get("calls", {}).get(api, {})
+            for field in ("ok", "ms", "heap", "stack"):
+                if before.get(field) != call.get(field):
+                    print("  %s %s %s: %s" % (fqbn, api, field, change(before.get(field), call.get(field))))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--fqbn", action="append",
+                        help="board to build for, can be given more than once (default arduino:avr:mega)")
+    parser.add_argument("--sketch", action="append",
+                        help="example to build, can be given more than once (default all)")
+    parser.add_argument("--port", help="run the Benchmark example on the board connected to this port")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=int, default=120, help="seconds to wait for the benchmark")
+    parser.add_argument("-o", "--output", help="file to write the report to (default stdout)")
+    parser.add_argument("--compare", help="earlier report to compare with")
+    args = parser.parse_args()
+
+    boards = args.fqbn or ["arduino:avr:mega"]
+    sketches = args.sketch or sorted(os.listdir(EXAMPLES))
+    report = {"version": version(), "sizes": {}, "benchmark": {}}
+
+    for fqbn in boards:
+        sizes = report["sizes"][fqbn] = {}
+        for sketch in sketches:
+            sizes[sketch] = compile_sketch(fqbn, os.path.join(EXAMPLES, sketch))
+            print("%s %s: %s" % (fqbn, sketch, sizes[sketch]), file=sys.stderr)
+
+        if args.port:
+            # Runs without waiting for the simulated GSM, so the board isn't tied up for long
+            uploaded = compile_sketch(fqbn, os.path.join(EXAMPLES, "Benchmark"), "-DGSM_VIRTUAL_CLOCK", args.port)
+            if "error" in uploaded:
+                print("%s Benchmark: %s" % (fqbn, uploaded["error"]), file=sys.stderr)
+            else:
+                report["benchmark"][fqbn] = collect(args.port, args.baud, args.timeout)
+
+    text = json.dumps(report, indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, "w") as output:
+            output.write(text + "\n")
+    else:
+        print(text)
+
+    if args.compare:
+        with open(args.compare) as earlier:
+            compare(json.load(earlier), report)
+
+
+if __name__ == "__main__":
+    main()
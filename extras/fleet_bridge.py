@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Forwards the requests written by the FleetSimulation example to a server.
+
+Each request is written between a line "#<device>" and a line "#end", it is
+sent to the server as it is and the time the server took to reply is printed.
+"#stats" lines and anything else are printed unchanged. Requests are sent
+from a pool of threads, so requests from different devices reach the server
+at the same time as they would from a real fleet.
+
+With --serial the board's serial port is opened directly (needs pyserial),
+and the time the server took is written back to the board as
+"#latency <device> <ms>", or "#failed <device>" if it couldn't be reached,
+for the sketch to add to its statistics. Otherwise the serial output is read
+from stdin and nothing is sent back:
+
+    python3 fleet_bridge.py --serial /dev/ttyUSB0 --port 8080
+    arduino-cli monitor -p /dev/ttyUSB0 -c baudrate=115200 | python3 fleet_bridge.py --port 8080
+"""
+
+import argparse
+import concurrent.futures
+import socket
+import sys
+import threading
+import time
+
+
+def forward(host, port, request):
+    """Sends the request and returns (seconds taken, status line)."""
+    start = time.monotonic()
+    with socket.create_connection((host, port), timeout=10) as connection:
+        connection.sendall(request)
+        reply = b""
+        while True:
+            data = connection.recv(4096)
+            if not data:
+                break
+            reply += data
+    status = reply.split(b"\r\n", 1)[0].decode("latin-1")
+    return time.monotonic() - start, status
+
+
+def serial_lines(port):
+    """Yields the lines read from the serial port, waiting for more when none arrive."""
+    while True:
+        line = port.readline()
+        if line:
+            yield line
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--serial", help="serial port of the board, the server's latency is sent back to it")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--workers", type=int, default=32, help="requests sent to the server at once")
+    args = parser.parse_args()
+
+    board = None
+    lines = sys.stdin.buffer
+    if args.serial:
+        import serial
+        board = serial.Serial(args.serial, args.baud, timeout=1)
+        lines = serial_lines(board)
+
+    lock = threading.Lock()
+    times = []
+
+    def send(device, request):
+        try:
+            taken, status = forward(args.host, args.port, request)
+        except OSError as error:
+            with lock:
+                print("device %s: failed, %s" % (device, error), flush=True)
+                if board:
+                    board.write(b"#failed %s\n" % device.encode())
+            return
+
+        with lock:
+            times.append(taken)
+            print("device %s: %s in %.0f ms" % (device, status, taken * 1000), flush=True)
+            if board:
+                board.write(b"#latency %s %d\n" % (device.encode(), round(taken * 1000)))
+
+    device = None
+    request = b""
+
+    with concurrent.futures.ThreadPoolExecutor(args.workers) as pool:
+        try:
+            for line in lines:
+                if device is None:
+                    text = line.decode("latin-1").rstrip("\r\n")
+                    if text.startswith("#") and text[1:].isdigit():
+                        device = text[1:]
+                        request = b""
+                    else:
+                        with lock:
+                            print(text, flush=True)
+                    continue
+
+                if line.rstrip(b"\r\n") == b"#end":
+                    # The simulator adds a new line before #end
+                    request = request[:-2] if request.endswith(b"\r\n") else request
+                    pool.submit(send, device, request)
+                    device = None
+                    continue
+
+                request += line
+        except KeyboardInterrupt:
+            pass
+
+    if times:
+        times.sort()
+        print("%d requests, median %.0f ms, slowest %.0f ms"
+              % (len(times), times[len(times) // 2] * 1000, times[-1] * 1000))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,178 @@
+#include "arduino.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long time) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(time));
+}
+
+void delayMicroseconds(unsigned int time) {
+  std::this_thread::sleep_for(std::chrono::microseconds(time));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+static thread_local uint8_t pins[256];
+
+void pinMode(uint8_t pin, uint8_t mode) { }
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  pins[pin] = value;
+}
+
+int digitalRead(uint8_t pin) {
+  return pins[pin];
+}
+
+int analogRead(uint8_t pin) {
+  return 0;
+}
+
+static thread_local std::minstd_rand generator;
+
+long random(long howBig) {
+  if (howBig <= 0) return 0;
+  return generator() % howBig;
+}
+
+long random(long howSmall, long howBig) {
+  if (howSmall >= howBig) return howSmall;
+  return howSmall + random(howBig - howSmall);
+}
+
+void randomSeed(unsigned long seed) {
+  generator.seed(seed);
+}
+
+static std::string toText(unsigned long value, unsigned char base, bool isNegative) {
+  char digits[34];
+  uint8_t length = 0;
+  do {
+    uint8_t digit = value % base;
+    digits[length++] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value > 0);
+  if (isNegative) digits[length++] = '-';
+
+  std::string text;
+  while (length > 0) text += digits[--length];
+  return text;
+}
+
+String::String(unsigned char value, unsigned char base) : text(toText(value, base, false)) { }
+String::String(unsigned int value, unsigned char base) : text(toText(value, base, false)) { }
+String::String(unsigned long value, unsigned char base) : text(toText(value, base, false)) { }
+
+String::String(int value, unsigned char base)
+  : text(base == DEC ? toText(value < 0 ? -(long) value : value, base, value < 0) : toText((unsigned int) value, base, false)) { }
+
+String::String(long value, unsigned char base)
+  : text(base == DEC ? toText(value < 0 ? -(unsigned long) value : value, base, value < 0) : toText((unsigned long) value, base, false)) { }
+
+String::String(double value, unsigned char decimalPlaces) {
+  char buffer[48];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+  text = buffer;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    unsigned int swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from >= text.size()) return String();
+  if (to > text.size()) to = text.size();
+
+  String part;
+  part.text = text.substr(from, to - from);
+  return part;
+}
+
+void String::replace(const String & find, const String & replace) {
+  if (find.text.empty()) return;
+  size_t position = 0;
+  while ((position = text.find(find.text, position)) != std::string::npos) {
+    text.replace(position, find.text.size(), replace.text);
+    position += replace.text.size();
+  }
+}
+
+void String::trim() {
+  size_t first = text.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    text.clear();
+    return;
+  }
+  size_t last = text.find_last_not_of(" \t\r\n");
+  text = text.substr(first, last - first + 1);
+}
+
+void String::toCharArray(char * buffer, unsigned int size) const {
+  if (size == 0) return;
+  strncpy(buffer, text.c_str(), size - 1);
+  buffer[size - 1] = '\0';
+}
+
+size_t Print::write(const uint8_t * data, size_t size) {
+  size_t written = 0;
+  while (size-- > 0) written += write(*data++);
+  return written;
+}
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) return c;
+  } while (millis() - start < timeout);
+  return -1;
+}
+
+size_t Stream::readBytes(char * buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) break;
+    buffer[count++] = c;
+  }
+  return count;
+}
+
+String Stream::readString() {
+  String text;
+  int c;
+  while ((c = timedRead()) >= 0) text += (char) c;
+  return text;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String text;
+  int c;
+  while ((c = timedRead()) >= 0 && c != terminator) text += (char) c;
+  return text;
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+HardwareSerial Serial;
@@ -0,0 +1,212 @@
+#ifndef _GSM_Host_Arduino_h
+#define _GSM_Host_Arduino_h
+
+/*
+  The parts of the Arduino core used by the library, for building it on
+  Linux with the Makefile in this folder. Flash is ordinary memory here,
+  so PROGMEM and F() do nothing, and String is kept in a std::string.
+  millis() and delay() use the PC's clock, random() is kept for each
+  thread so devices run on different threads don't share it.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) ((const __FlashStringHelper *) (s))
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+#define pgm_read_word(address) (*(const uint16_t *) (address))
+#define pgm_read_dword(address) (*(const uint32_t *) (address))
+#define pgm_read_ptr(address) (*(void * const *) (address))
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strstr_P strstr
+#define strlen_P strlen
+#define snprintf_P snprintf
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEC 10
+#define HEX 16
+
+class __FlashStringHelper;
+
+template <typename A, typename B> inline A min(A a, B b) { return b < a ? (A) b : a; }
+template <typename A, typename B> inline A max(A a, B b) { return a < b ? (A) b : a; }
+template <typename T, typename L, typename H> inline T constrain(T x, L low, H high) {
+  return x < low ? (T) low : (x > high ? (T) high : x);
+}
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long time);
+void delayMicroseconds(unsigned int time);
+void yield();
+
+// There are no pins, writes are kept so they can be read back
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+class String {
+public:
+  String(const char * text = "") : text(text != NULL ? text : "") { }
+  String(const __FlashStringHelper * text) : text((const char *) text) { }
+  explicit String(char c) : text(1, c) { }
+  explicit String(unsigned char value, unsigned char base = DEC);
+  explicit String(int value, unsigned char base = DEC);
+  explicit String(unsigned int value, unsigned char base = DEC);
+  explicit String(long value, unsigned char base = DEC);
+  explicit String(unsigned long value, unsigned char base = DEC);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  unsigned int length() const { return text.size(); }
+  const char * c_str() const { return text.c_str(); }
+  bool reserve(unsigned int size) { text.reserve(size); return true; }
+  char charAt(unsigned int index) const { return index < text.size() ? text[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  int indexOf(char c, unsigned int from = 0) const { return found(text.find(c, from)); }
+  int indexOf(const String & other, unsigned int from = 0) const { return found(text.find(other.text, from)); }
+  int lastIndexOf(char c) const { return found(text.rfind(c)); }
+  int lastIndexOf(const String & other) const { return found(text.rfind(other.text)); }
+  bool startsWith(const String & other) const { return text.compare(0, other.text.size(), other.text) == 0; }
+  bool endsWith(const String & other) const {
+    return text.size() >= other.text.size() && text.compare(text.size() - other.text.size(), other.text.size(), other.text) == 0;
+  }
+  String substring(unsigned int from) const { return substring(from, text.size()); }
+  String substring(unsigned int from, unsigned int to) const;
+  void remove(unsigned int index) { if (index < text.size()) text.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < text.size()) text.erase(index, count); }
+  void replace(const String & find, const String & replace);
+  void trim();
+  void toCharArray(char * buffer, unsigned int size) const;
+  long toInt() const { return atol(text.c_str()); }
+  bool equals(const String & other) const { return text == other.text; }
+
+  String & operator+=(const String & other) { text += other.text; return *this; }
+  String & operator+=(const char * other) { text += other; return *this; }
+  String & operator+=(const __FlashStringHelper * other) { text += (const char *) other; return *this; }
+  String & operator+=(char c) { text += c; return *this; }
+  String & operator+=(unsigned char value) { return *this += String(value); }
+  String & operator+=(int value) { return *this += String(value); }
+  String & operator+=(unsigned int value) { return *this += String(value); }
+  String & operator+=(long value) { return *this += String(value); }
+  String & operator+=(unsigned long value) { return *this += String(value); }
+  bool concat(const String & other) { text += other.text; return true; }
+
+  bool operator==(const String & other) const { return text == other.text; }
+  bool operator==(const char * other) const { return text == other; }
+  bool operator!=(const String & other) const { return text != other.text; }
+  bool operator!=(const char * other) const { return text != other; }
+
+private:
+  std::string text;
+
+  static int found(size_t position) { return position == std::string::npos ? -1 : (int) position; }
+};
+
+template <typename T> inline String operator+(const String & text, const T & value) {
+  String sum = text;
+  sum += value;
+  return sum;
+}
+inline String operator+(const char * text, const String & other) {
+  String sum = text;
+  sum += other;
+  return sum;
+}
+inline String operator+(const __FlashStringHelper * text, const String & other) {
+  String sum = text;
+  sum += other;
+  return sum;
+}
+
+class Print {
+public:
+  virtual ~Print() { }
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t * data, size_t size);
+  size_t write(const char * text) { return text != NULL ? write((const uint8_t *) text, strlen(text)) : 0; }
+  size_t write(const char * data, size_t size) { return write((const uint8_t *) data, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() { }
+
+  size_t print(const __FlashStringHelper * text) { return write((const char *) text); }
+  size_t print(const String & text) { return write(text.c_str()); }
+  size_t print(const char * text) { return write(text); }
+  size_t print(char c) { return write((uint8_t) c); }
+  size_t print(unsigned char value, int base = DEC) { return print(String(value, base)); }
+  size_t print(int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(double value, int decimalPlaces = 2) { return print(String(value, decimalPlaces)); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T & value) {
+    size_t length = print(value);
+    return length + println();
+  }
+  template <typename T> size_t println(const T & value, int format) {
+    size_t length = print(value, format);
+    return length + println();
+  }
+};
+
+class Stream : public Print {
+public:
+  Stream() : timeout(1000) { }
+
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { this->timeout = timeout; }
+  size_t readBytes(char * buffer, size_t length);
+  String readString();
+  String readStringUntil(char terminator);
+
+protected:
+  unsigned long timeout;
+
+  int timedRead();
+};
+
+/*
+  Serial writes to stdout and never has anything to read. There are
+  no other serial ports, the library is given a GSM_Simulator instead.
+*/
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) { }
+  void begin(unsigned long baud, uint8_t config) { }
+  void end() { }
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  void flush();
+  size_t write(uint8_t c);
+  using Print::write;
+  operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
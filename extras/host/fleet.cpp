@@ -0,0 +1,428 @@
+/*
+  Load tests a server with a fleet of simulated devices, each running the
+  library's own bring up and getRequest() against its own GSM_Simulator.
+  The data each device sends over TCP is forwarded to the server, and the
+  time the server takes to reply is measured along with how long each
+  request took on the device.
+
+    make
+    ./fleet --devices 1000 --workers 32 --requests 10 --port 8080
+
+  Every device has its own GSM_VirtualClock, so a device's waits for its
+  simulated GSM take no real time and its latency is the time it would
+  have taken on the device. The devices are run by a pool of threads.
+  A thread takes the next device from a queue, brings it up or makes its
+  next request, then puts it back at the end of the queue, so every device
+  keeps its place in the fleet while only --workers run at once. Requests
+  reach the server as fast as the threads can make them, use --workers
+  to change how many the server is sent at the same time.
+
+  Each device is given a random profile: the GSM's latency, jitter,
+  signal, time to register and how often it answers with an error or
+  not at all. --seed gives the same fleet again. A report is printed
+  at the end, or with --json a single line of JSON.
+*/
+
+#include "GSM_A6.h"
+#include "GSM_Simulator.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define RESET_PIN 2 // Pins are kept for each thread, so every device can use the same one
+#define SERVER_TIMEOUT 10 // Seconds to wait for the server
+
+struct Options {
+  unsigned devices = 200;
+  unsigned workers = 32;
+  unsigned requests = 5;       // Requests made by each device after bringing it up
+  unsigned long interval = 60000; // Milliseconds of device time between requests
+  const char * host = "localhost";
+  const char * port = NULL;    // Requests aren't forwarded when not given
+  unsigned long seed = 1;
+  bool isJson = false;
+};
+
+static Options options;
+
+/*
+  Time taken by each request, in milliseconds
+*/
+class Latencies {
+public:
+  void add(unsigned long time) { times.push_back(time); }
+  void add(const Latencies & other) { times.insert(times.end(), other.times.begin(), other.times.end()); }
+  size_t count() const { return times.size(); }
+  void sort() { std::sort(times.begin(), times.end()); }
+
+  // Call sort() first
+  unsigned long percentile(unsigned percent) const {
+    if (times.empty()) return 0;
+    return times[std::min(times.size() - 1, times.size() * percent / 100)];
+  }
+
+private:
+  std::vector<unsigned long> times;
+};
+
+/*
+  Everything the devices have done, each thread adds up its own
+  and they are added together once the threads have finished.
+*/
+struct Totals {
+  unsigned long broughtUp = 0;
+  unsigned long bringUpsFailed = 0;
+  unsigned long succeeded = 0;
+  unsigned long failed = 0;
+  unsigned long forwarded = 0;    // Requests the server replied to
+  unsigned long serverFailed = 0; // Requests the server couldn't be reached for
+  unsigned long serverErrors = 0; // Replies without a 2xx status
+  Latencies bringUp;
+  Latencies device;
+  Latencies server;
+
+  void add(const Totals & other) {
+    broughtUp += other.broughtUp;
+    bringUpsFailed += other.bringUpsFailed;
+    succeeded += other.succeeded;
+    failed += other.failed;
+    forwarded += other.forwarded;
+    serverFailed += other.serverFailed;
+    serverErrors += other.serverErrors;
+    bringUp.add(other.bringUp);
+    device.add(other.device);
+    server.add(other.server);
+  }
+};
+
+/*
+  Sends the request to the server and waits for the whole reply.
+
+  @return the status code of the reply, 0 if the server couldn't be reached
+*/
+static int forward(const std::string & request) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo * addresses;
+  if (getaddrinfo(options.host, options.port, &hints, &addresses) != 0) return 0;
+
+  int connection = -1;
+  for (addrinfo * address = addresses; address != NULL && connection < 0; address = address->ai_next) {
+    connection = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (connection < 0) continue;
+
+    timeval timeout = { SERVER_TIMEOUT, 0 };
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(connection, address->ai_addr, address->ai_addrlen) != 0) {
+      close(connection);
+      connection = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (connection < 0) return 0;
+
+  int status = 0;
+  if (send(connection, request.data(), request.size(), MSG_NOSIGNAL) == (ssize_t) request.size()) {
+    // The request asks for the connection to be closed, so the reply ends when it is
+    std::string reply;
+    char buffer[1024];
+    ssize_t length;
+    while ((length = recv(connection, buffer, sizeof(buffer), 0)) > 0) {
+      reply.append(buffer, length);
+    }
+    if (length == 0 && sscanf(reply.c_str(), "HTTP/%*s %d", &status) != 1) status = 0;
+  }
+  close(connection);
+  return status;
+}
+
+/*
+  Receives the data a GSM_Simulator sends over TCP, which is written
+  between a line with # and the device number and a line with #end,
+  and forwards each request to the server.
+*/
+class ServerBridge : public Print {
+public:
+  Totals * totals; // Of the thread running the device
+
+  size_t write(uint8_t c) {
+    data += (char) c;
+    if (data.size() >= END_LENGTH && data.compare(data.size() - END_LENGTH, END_LENGTH, END) == 0) {
+      size_t start = data.find("\r\n") + 2;
+      std::string request = data.substr(start, data.size() - END_LENGTH - start);
+      data.clear();
+      if (options.port != NULL) send(request);
+    }
+    return 1;
+  }
+  using Print::write;
+
+private:
+  static constexpr const char * END = "\r\n#end\r\n";
+  static const size_t END_LENGTH = 8;
+
+  std::string data;
+
+  void send(const std::string & request) {
+    unsigned long start = micros();
+    int status = forward(request);
+    if (status == 0) {
+      ++totals->serverFailed;
+      return;
+    }
+
+    ++totals->forwarded;
+    if (status < 200 || status > 299) ++totals->serverErrors;
+    totals->server.add((micros() - start) / 1000);
+  }
+};
+
+struct Device {
+  unsigned number;
+  GSM_VirtualClock clock;
+  GSM_Simulator simulator;
+  ServerBridge bridge;
+  GSM_A6 gsm;
+  unsigned requestsMade;
+  bool isBroughtUp;
+
+  Device(unsigned number) : number(number), gsm(simulator, RESET_PIN), requestsMade(0), isBroughtUp(false) { }
+};
+
+/*
+  Gives the device's GSM a random profile, most are reliable
+  and a few have a poor signal or an unreliable GSM.
+*/
+static void randomProfile(Device & device, std::minstd_rand & random) {
+  GSM_Simulator & simulator = device.simulator;
+  // Replies must arrive within the 150ms init waits for AT to be answered
+  simulator.latency = 20 + random() % 60;
+  simulator.jitter = random() % 60;
+  simulator.signal = 5 + random() % 27;
+  simulator.registerTime = 2000 + random() % 28000;
+  simulator.resetPin = RESET_PIN;
+
+  unsigned reliability = random() % 100;
+  if (reliability >= 95) {
+    simulator.errorRate = 10 + random() % 10;
+    simulator.silenceRate = 2 + random() % 4;
+  } else if (reliability >= 75) {
+    simulator.errorRate = 1 + random() % 5;
+  }
+}
+
+/*
+  Brings the device up, or makes its next request.
+
+  @return true if the device has more to do
+*/
+static bool runDevice(Device & device, Totals & totals) {
+  GSM_useClock(device.clock);
+  randomSeed(options.seed * 1000003UL + device.number * 1009UL + device.requestsMade);
+  device.bridge.totals = &totals;
+  GSM_A6 & gsm = device.gsm;
+
+  if (!device.isBroughtUp) {
+    unsigned long start = device.clock.millis();
+    if (!(gsm.init() && gsm.waitForNetwork() && gsm.connectToAPN(F("everywhere"), F("eesecure"), F("secure")))) {
+      ++totals.bringUpsFailed;
+      return false;
+    }
+    ++totals.broughtUp;
+    totals.bringUp.add(device.clock.millis() - start);
+    device.isBroughtUp = true;
+    return options.requests > 0;
+  }
+
+  device.clock.advance(options.interval);
+  String resource = "/reading?device=" + String(device.number) + "&T=" + String(random(100));
+  unsigned long start = device.clock.millis();
+  if (gsm.getRequest(options.host, resource)) {
+    ++totals.succeeded;
+    totals.device.add(device.clock.millis() - start);
+  } else {
+    ++totals.failed;
+  }
+  return ++device.requestsMade < options.requests;
+}
+
+/*
+  The devices waiting for a thread, in the order they are run
+*/
+class DeviceQueue {
+public:
+  DeviceQueue() : running(0) { }
+
+  void add(Device * device) {
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.push_back(device);
+    changed.notify_one();
+  }
+
+  // @return the next device to run, NULL once every device has finished
+  Device * next() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return !devices.empty() || running == 0; });
+    if (devices.empty()) return NULL;
+
+    Device * device = devices.front();
+    devices.pop_front();
+    ++running;
+    return device;
+  }
+
+  void done(Device * device, bool hasMore) {
+    std::lock_guard<std::mutex> lock(mutex);
+    --running;
+    if (hasMore) devices.push_back(device);
+    changed.notify_all();
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<Device *> devices;
+  unsigned running;
+};
+
+static void printLatencies(const char * name, const Latencies & latencies) {
+  printf("%-22s %8lu %8lu %8lu %8lu\n", name, latencies.percentile(50), latencies.percentile(90),
+         latencies.percentile(99), latencies.percentile(100));
+}
+
+static void printJsonLatencies(const char * name, const Latencies & latencies) {
+  printf(",\"%s\":{\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu}", name, latencies.percentile(50),
+         latencies.percentile(90), latencies.percentile(99), latencies.percentile(100));
+}
+
+static bool readOptions(int argc, char ** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char * name = argv[i];
+    const char * value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (strcmp(name, "--json") == 0) {
+      options.isJson = true;
+      continue;
+    }
+    if (value == NULL) return false;
+    ++i;
+
+    if (strcmp(name, "--devices") == 0) {
+      options.devices = strtoul(value, NULL, 10);
+    } else if (strcmp(name, "--workers") == 0) {
+      options.workers = std::max(1UL, strtoul(value, NULL, 10));
+    } else if (strcmp(name, "--requests") == 0) {
+      options.requests = strtoul(value, NULL, 10);
+    } else if (strcmp(name, "--interval") == 0) {
+      options.interval = strtoul(value, NULL, 10);
+    } else if (strcmp(name, "--host") == 0) {
+      options.host = value;
+    } else if (strcmp(name, "--port") == 0) {
+      options.port = value;
+    } else if (strcmp(name, "--seed") == 0) {
+      options.seed = strtoul(value, NULL, 10);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char ** argv) {
+  if (!readOptions(argc, argv)) {
+    fprintf(stderr, "usage: %s [--devices 200] [--workers 32] [--requests 5] [--interval 60000]\n"
+                    "       [--host localhost] [--port <port>] [--seed 1] [--json]\n", argv[0]);
+    return 2;
+  }
+
+  std::minstd_rand random(options.seed);
+  std::vector<Device *> devices;
+  DeviceQueue queue;
+  for (unsigned i = 0; i < options.devices; ++i) {
+    Device * device = new Device(i);
+    randomProfile(*device, random);
+    device->simulator.bridgeTo(device->bridge, i);
+    devices.push_back(device);
+    queue.add(device);
+  }
+
+  std::vector<Totals> threadTotals(options.workers);
+  std::vector<std::thread> threads;
+  unsigned long start = micros();
+
+  for (unsigned i = 0; i < options.workers; ++i) {
+    Totals & totals = threadTotals[i];
+    threads.push_back(std::thread([&queue, &totals] {
+      Device * device;
+      while ((device = queue.next()) != NULL) {
+        bool hasMore = runDevice(*device, totals);
+        queue.done(device, hasMore);
+      }
+    }));
+  }
+  for (std::thread & thread : threads) thread.join();
+
+  double seconds = (micros() - start) / 1e6;
+  Totals totals;
+  for (const Totals & other : threadTotals) totals.add(other);
+  totals.bringUp.sort();
+  totals.device.sort();
+  totals.server.sort();
+
+  unsigned long retries = 0;
+  unsigned long rejected = 0;
+  unsigned long recoveries = 0;
+  for (Device * device : devices) {
+    const GSM_Metrics & metrics = device->gsm.getMetrics();
+    retries += metrics.retries;
+    rejected += metrics.rejectedRequests;
+    recoveries += metrics.recoveries;
+    delete device;
+  }
+
+  unsigned long requests = totals.succeeded + totals.failed;
+  if (options.isJson) {
+    printf("{\"devices\":%u,\"workers\":%u,\"seconds\":%.3f,\"requests\":%lu,\"perSecond\":%.1f",
+           options.devices, options.workers, seconds, requests, requests / seconds);
+    printf(",\"broughtUp\":%lu,\"bringUpsFailed\":%lu,\"succeeded\":%lu,\"failed\":%lu",
+           totals.broughtUp, totals.bringUpsFailed, totals.succeeded, totals.failed);
+    printf(",\"retries\":%lu,\"rejected\":%lu,\"recoveries\":%lu", retries, rejected, recoveries);
+    printf(",\"forwarded\":%lu,\"serverFailed\":%lu,\"serverErrors\":%lu",
+           totals.forwarded, totals.serverFailed, totals.serverErrors);
+    printJsonLatencies("bringUpMs", totals.bringUp);
+    printJsonLatencies("requestMs", totals.device);
+    printJsonLatencies("serverMs", totals.server);
+    printf("}\n");
+    return 0;
+  }
+
+  printf("Devices:     %u on %u threads, %lu brought up, %lu failed to\n",
+         options.devices, options.workers, totals.broughtUp, totals.bringUpsFailed);
+  printf("Requests:    %lu in %.2f seconds, %.1f per second\n", requests, seconds, requests / seconds);
+  printf("Succeeded:   %lu, failed %lu\n", totals.succeeded, totals.failed);
+  printf("Retries:     %lu commands and requests tried again, %lu rejected, %lu recoveries\n",
+         retries, rejected, recoveries);
+  if (options.port != NULL) {
+    printf("Server:      %lu replied, %lu without a 2xx status, %lu couldn't reach it\n",
+           totals.forwarded, totals.serverErrors, totals.serverFailed);
+  } else {
+    printf("Server:      not used, give --port to forward the requests\n");
+  }
+  printf("\n%-22s %8s %8s %8s %8s\n", "Milliseconds", "p50", "p90", "p99", "max");
+  printLatencies("Bring up (device)", totals.bringUp);
+  printLatencies("Request (device)", totals.device);
+  if (options.port != NULL) printLatencies("Request (server)", totals.server);
+  return 0;
+}